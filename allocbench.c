@@ -0,0 +1,111 @@
+// Page allocator benchmark.
+// Starts workers, one or more per CPU, that each allocate and
+// free pages a fixed number of rounds, and times how long they
+// all take. In the first test a round grows the worker's heap
+// by NPAGE pages, touches each and shrinks it again. In the
+// second a round forks a child that touches NPAGE fresh heap
+// pages and exits, so the pages, the child's page tables and its
+// kernel stack are all allocated on one CPU and freed on the
+// CPU the parent reaps it from. Reports pages per second. Boot
+// with make qemu CPUS=1, 2, 4 and 8 to compare.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define NPAGE     16     // pages each round allocates
+#define PGSIZE    4096
+#define TICKSEC   100    // timer ticks per second
+
+// Grow the heap by NPAGE pages and write to each.
+// Return the new pages.
+char*
+touch(void)
+{
+  char *a;
+  int i;
+
+  if((a = sbrk(NPAGE*PGSIZE)) == (char*)-1){
+    printf(2, "allocbench: sbrk failed\n");
+    exit();
+  }
+  for(i = 0; i < NPAGE; i++)
+    a[i*PGSIZE] = 1;
+  return a;
+}
+
+void
+sbrkrounds(int n)
+{
+  while(n-- > 0){
+    touch();
+    sbrk(-NPAGE*PGSIZE);
+  }
+}
+
+void
+forkrounds(int n)
+{
+  int pid;
+
+  while(n-- > 0){
+    if((pid = fork()) < 0){
+      printf(2, "allocbench: fork failed\n");
+      exit();
+    }
+    if(pid == 0){
+      touch();
+      exit();
+    }
+    wait();
+  }
+}
+
+// Run f(rounds) in nworker children at once and
+// return the ticks until the last one exits.
+int
+timed(void (*f)(int), int nworker, int rounds)
+{
+  int i, t, pid;
+
+  t = uptime();
+  for(i = 0; i < nworker; i++){
+    if((pid = fork()) < 0){
+      printf(2, "allocbench: fork failed\n");
+      exit();
+    }
+    if(pid == 0){
+      f(rounds);
+      exit();
+    }
+  }
+  for(i = 0; i < nworker; i++)
+    wait();
+  t = uptime() - t;
+  return t > 0 ? t : 1;
+}
+
+void
+report(char *what, int nworker, int rounds, int t)
+{
+  int pages = nworker * rounds * NPAGE;
+
+  printf(1, "%s: %d workers x %d rounds: %d pages in %d ticks, %d/sec\n",
+         what, nworker, rounds, pages, t, pages * TICKSEC / t);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nworker, rounds;
+
+  nworker = argc > 1 ? atoi(argv[1]) : 4;
+  rounds = argc > 2 ? atoi(argv[2]) : 1000;
+  if(nworker <= 0 || rounds <= 0){
+    printf(2, "usage: allocbench [workers] [rounds]\n");
+    exit();
+  }
+  report("sbrk", nworker, rounds, timed(sbrkrounds, nworker, rounds));
+  report("fork", nworker, rounds, timed(forkrounds, nworker, rounds));
+  exit();
+}
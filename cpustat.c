@@ -0,0 +1,50 @@
+// Report how busy each CPU is.
+// Samples the per-CPU tick counts twice, the given number of
+// ticks apart (default 100), and prints the share of the
+// interval each CPU spent running processes, how many
+// reschedule IPIs woke it from idle, its load average and how
+// many processes the load balancer moved to it.
+
+#include "param.h"
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "cpustat.h"
+
+struct cpustat before[NCPU], after[NCPU];
+
+int
+main(int argc, char *argv[])
+{
+  int interval, n, i, busy, idle, totalbusy, total;
+
+  interval = argc > 1 ? atoi(argv[1]) : 100;
+  if(interval <= 0){
+    printf(2, "usage: cpustat [ticks]\n");
+    exit();
+  }
+
+  if((n = cpuinfo(before)) < 0){
+    printf(2, "cpustat: cpuinfo failed\n");
+    exit();
+  }
+  sleep(interval);
+  cpuinfo(after);
+
+  totalbusy = total = 0;
+  printf(1, "cpu\tbusy\tidle\tutil\tipis\tload\tpulled\n");
+  for(i = 0; i < n; i++){
+    busy = after[i].busy - before[i].busy;
+    idle = after[i].idle - before[i].idle;
+    totalbusy += busy;
+    total += busy + idle;
+    printf(1, "%d\t%d\t%d\t%d%%\t%d\t%d.%d%d\t%d\n", after[i].cpu,
+           busy, idle, busy + idle > 0 ? busy * 100 / (busy + idle) : 0,
+           after[i].nresched - before[i].nresched, after[i].load / 100,
+           after[i].load / 10 % 10, after[i].load % 10,
+           after[i].npulled - before[i].npulled);
+  }
+  printf(1, "all\t%d%% of %d cpus\n",
+         total > 0 ? totalbusy * 100 / total : 0, n);
+  exit();
+}
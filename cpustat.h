@@ -0,0 +1,8 @@
+struct cpustat {
+  int cpu;
+  int busy;      // Timer ticks spent running a process
+  int idle;      // Timer ticks spent idle in the scheduler
+  int nresched;  // Reschedule IPIs received
+  int load;      // Average of runnable processes, times 100
+  int npulled;   // Processes the load balancer moved here
+};
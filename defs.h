@@ -10,6 +10,14 @@ struct sleeplock;
 struct stat;
 struct superblock;
 struct procstat;
+struct cpustat;
+struct memstat;
+struct slabcache;
+struct slabstat;
+struct timer;
+struct rbnode;
+struct rbtree;
+struct schedops;
 
 // bio.c
 void            binit(void);
@@ -69,6 +77,11 @@ char*           kalloc(void);
 void            kfree(char*);
 void            kinit1(void*, void*);
 void            kinit2(void*, void*);
+char*           kalloc_pages(int);
+void            kfree_pages(char*, int);
+void            meminfo(struct memstat*);
+void            kref(char*);
+int             krefs(char*);
 
 // kbd.c
 void            kbdintr(void);
@@ -79,7 +92,10 @@ int             lapicid(void);
 extern volatile uint*    lapic;
 void            lapiceoi(void);
 void            lapicinit(void);
+void            lapicipi(int, int);
 void            lapicstartap(uchar, uint);
+uint64          nsecs(void);
+void            tscinit(void);
 void            microdelay(int);
 
 // log.c
@@ -97,6 +113,7 @@ void            picenable(int);
 void            picinit(void);
 
 // pipe.c
+void            pipeinit(void);
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
 int             piperead(struct pipe*, char*, int);
@@ -104,8 +121,9 @@ int             pipewrite(struct pipe*, char*, int);
 
 //PAGEBREAK: 16
 // proc.c
-void            addproc(struct proc *, int);
+void            balance(void);
 int             cpuid(void);
+int             cpuinfo(struct cpustat*);
 void            exit(void);
 int             fork(void);
 int             growproc(int);
@@ -114,20 +132,43 @@ struct cpu*     mycpu(void);
 struct proc*    myproc();
 void            pinit(void);
 void            procdump(void);
-void            processinfo(struct procstat *);
-void            qinit(void);
-void            removeproc(struct proc *, int);
+int             processinfo(struct procstat *, int, int);
+int             preempt(struct proc*);
+void            rttick(void);
+int             rtwait(void);
+int             schedctl(int);
 void            scheduler(void) __attribute__((noreturn));
 void            sched(void);
 int             setpriority(int, int);
+int             lendpriority(struct proc*, int);
+void            restorepriority(struct proc*, int);
+int             setaffinity(int, int);
+int             setrt(int, int, int);
+int             settickets(int, int);
 void            setproc(struct proc*);
 void            sleep(void*, struct spinlock*);
 void            updatetime(void);
 void            userinit(void);
 int             wait(void);
 int             waitx(int*, int*);
+int             waitxns(uint64*, uint64*);
 void            wakeup(void*);
+void            wakeone(void*);
 void            yield(void);
+int             yieldto(int);
+
+// rbtree.c
+void            rberase(struct rbtree*, struct rbnode*);
+void            rbinsert(struct rbtree*, struct rbnode*);
+struct rbnode*  rbnext(struct rbnode*);
+
+// sched.c
+void            addproc(struct proc *, int);
+int             homecpu(struct proc*);
+extern struct schedops *policy;
+void            qinit(void);
+void            removeproc(struct proc *, int);
+extern struct schedops *schedops[];
 
 // swtch.S
 void            swtch(struct context**, struct context*);
@@ -138,14 +179,22 @@ void            getcallerpcs(void*, uint*);
 int             holding(struct spinlock*);
 void            initlock(struct spinlock*, char*);
 void            release(struct spinlock*);
+int             tryacquire(struct spinlock*);
 void            pushcli(void);
 void            popcli(void);
 
+// slab.c
+void            slabinit(struct slabcache*, char*, uint, void (*)(void*));
+void*           slaballoc(struct slabcache*);
+void            slabfree(struct slabcache*, void*);
+int             slabinfo(struct slabstat*, int);
+
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
 void            releasesleep(struct sleeplock*);
 int             holdingsleep(struct sleeplock*);
 void            initsleeplock(struct sleeplock*, char*);
+void            piinit(void);
 
 // string.c
 int             memcmp(const void*, const void*, uint);
@@ -159,13 +208,19 @@ char*           strncpy(char*, const char*, int);
 // syscall.c
 int             argint(int, int*);
 int             argptr(int, char**, int);
+int             argptrw(int, char**, int);
 int             argstr(int, char**);
 int             fetchint(uint, int*);
 int             fetchstr(uint, char**);
 void            syscall(void);
 
 // timer.c
-void            timerinit(void);
+void            timeradd(struct timer*, uint);
+void            timerdel(struct timer*);
+void            timerinit(struct timer*, void (*)(void*), void*);
+void            timertick(void);
+int             sleepuntil(uint);
+int             sleepticks(uint);
 
 // trap.c
 void            idtinit(void);
@@ -189,6 +244,9 @@ void            freevm(pde_t*);
 void            inituvm(pde_t*, char*, uint);
 int             loaduvm(pde_t*, char*, struct inode*, uint, uint);
 pde_t*          copyuvm(pde_t*, uint);
+int             cowfault(pde_t*, uint);
+int             uvmprepare(pde_t*, uint, uint, uint, int);
+int             lazyfault(pde_t*, uint, uint);
 void            switchuvm(struct proc*);
 void            switchkvm(void);
 int             copyout(pde_t*, uint, void*, uint);
@@ -0,0 +1,78 @@
+// Fork latency benchmark.
+// Grows the heap by the given number of KB and writes to every
+// page, then times rounds of fork+exit+wait, and of fork+exec of
+// a program that exits at once, as the shell does for every
+// command. Fork shares the heap copy-on-write, so neither should
+// grow with the heap, as they did when fork copied every page.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define HEAPKB  4096   // default heap size in KB
+#define NROUND  100    // default number of rounds
+#define PGSIZE  4096
+#define USPERTICK 10000  // microseconds per timer tick
+
+void
+report(char *what, int n, int t)
+{
+  printf(1, "%s: %d rounds in %d ticks, %d us each\n",
+         what, n, t, t * USPERTICK / n);
+}
+
+int
+main(int argc, char *argv[])
+{
+  char *heap, *args[3];
+  int heapkb, n, i, t, pid;
+
+  // Exec'd by the fork+exec rounds below.
+  if(argc > 1 && strcmp(argv[1], "-x") == 0)
+    exit();
+
+  heapkb = argc > 1 ? atoi(argv[1]) : HEAPKB;
+  n = argc > 2 ? atoi(argv[2]) : NROUND;
+  if(heapkb < 0 || n <= 0){
+    printf(2, "usage: forkbench [heapkb] [rounds]\n");
+    exit();
+  }
+  if((heap = sbrk(heapkb * 1024)) == (char*)-1){
+    printf(2, "forkbench: sbrk failed\n");
+    exit();
+  }
+  for(i = 0; i < heapkb * 1024; i += PGSIZE)
+    heap[i] = 1;
+
+  t = uptime();
+  for(i = 0; i < n; i++){
+    if((pid = fork()) < 0){
+      printf(2, "forkbench: fork failed\n");
+      exit();
+    }
+    if(pid == 0)
+      exit();
+    wait();
+  }
+  report("fork+exit", n, uptime() - t);
+
+  args[0] = argv[0];
+  args[1] = "-x";
+  args[2] = 0;
+  t = uptime();
+  for(i = 0; i < n; i++){
+    if((pid = fork()) < 0){
+      printf(2, "forkbench: fork failed\n");
+      exit();
+    }
+    if(pid == 0){
+      exec(args[0], args);
+      printf(2, "forkbench: exec %s failed\n", args[0]);
+      exit();
+    }
+    wait();
+  }
+  report("fork+exec", n, uptime() - t);
+  printf(1, "heap %d KB\n", heapkb);
+  exit();
+}
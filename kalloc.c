@@ -1,13 +1,17 @@
 // Physical memory allocator, intended to allocate
 // memory for user processes, kernel stacks, page table pages,
-// and pipe buffers. Allocates 4096-byte pages.
+// and pipe buffers. Allocates 4096-byte pages, or physically
+// contiguous blocks of 2^order pages with kalloc_pages().
 
 #include "types.h"
 #include "defs.h"
 #include "param.h"
 #include "memlayout.h"
 #include "mmu.h"
+#include "x86.h"
 #include "spinlock.h"
+#include "proc.h"
+#include "memstat.h"
 
 void freerange(void *vstart, void *vend);
 extern char end[]; // first address after kernel loaded from ELF file
@@ -15,14 +19,62 @@ extern char end[]; // first address after kernel loaded from ELF file
 
 struct run {
   struct run *next;
+  struct run *prev;     // Only kept on the buddy lists
 };
 
+// Free memory is managed as a buddy system. A free block of
+// order k is 2^k pages starting at a physical page number that
+// is a multiple of 2^k, and sits on kmem.free[k]. Its buddy is
+// the block of the same order it was split from, whose page
+// number differs only in bit k; when both are free they are
+// joined into a block of order k+1. pgstate[] marks the first
+// page of each free block with its order, so a buddy is found
+// and checked in O(1).
 struct {
   struct spinlock lock;
   int use_lock;
-  struct run *freelist;
+  struct run *free[NORDER];   // Free blocks of each order
+  int nblocks[NORDER];        // Blocks on each of free[]
+  int nfree;                  // Pages on free[]
+  int npages;                 // Pages given to the allocator
 } kmem;
 
+#define NPHYSPG (PHYSTOP/PGSIZE)
+#define PGFREE  0x80          // pgstate: first page of a free block
+
+static uchar pgstate[NPHYSPG];
+
+// The number of page tables mapping each page that kalloc()
+// handed out, which fork() shares copy-on-write: kalloc() sets
+// it to 1, kref() adds one and kfree() only frees the page when
+// it drops to 0. Updated with atomic adds, without a lock.
+static volatile ushort pgref[NPHYSPG];
+
+#define PGNUM(v)  (V2P(v) / PGSIZE)
+#define PNRUN(n)  ((struct run*)P2V((n) * PGSIZE))
+
+// Each cpu keeps a cache of free pages, so that kalloc() and
+// kfree() don't all serialize on kmem.lock. A cpu refills its
+// empty cache with a block of KBATCH pages, or KBATCH single
+// pages when there is no such block, or when memory is short
+// steals half of another cpu's cache, and gives KBATCH pages
+// back when it holds more than KCACHE. Each cache has a lock
+// only for stealing, so it is almost never contended. At most
+// one of these locks is held at a time. Pages in the caches are
+// not free as far as the buddy system is concerned, and can't be
+// joined with their buddies until they are given back.
+#define KBATCHORDER 5
+#define KBATCH (1 << KBATCHORDER)
+#define KCACHE (2*KBATCH)
+
+struct kcache {
+  struct spinlock lock;
+  struct run *freelist;
+  int n;                // Pages on freelist
+};
+
+static struct kcache kcache[NCPU];
+
 // Initialization happens in two phases.
 // 1. main() calls kinit1() while still using entrypgdir to place just
 // the pages mapped by entrypgdir on free list.
@@ -32,6 +84,8 @@ void
 kinit1(void *vstart, void *vend)
 {
   initlock(&kmem.lock, "kmem");
+  for(int i = 0; i < NCPU; i++)
+    initlock(&kcache[i].lock, "kcache");
   kmem.use_lock = 0;
   freerange(vstart, vend);
 }
@@ -48,10 +102,123 @@ freerange(void *vstart, void *vend)
 {
   char *p;
   p = (char*)PGROUNDUP((uint)vstart);
-  for(; p + PGSIZE <= (char*)vend; p += PGSIZE)
+  for(; p + PGSIZE <= (char*)vend; p += PGSIZE){
+    kmem.npages++;
     kfree(p);
+  }
 }
+
 //PAGEBREAK: 21
+// Put block r of the given order on its free list.
+static void
+blkpush(struct run *r, int order)
+{
+  r->prev = 0;
+  r->next = kmem.free[order];
+  if(r->next)
+    r->next->prev = r;
+  kmem.free[order] = r;
+  kmem.nblocks[order]++;
+  pgstate[PGNUM(r)] = PGFREE | order;
+}
+
+// Take block r of the given order off its free list.
+static void
+blkremove(struct run *r, int order)
+{
+  if(r->prev)
+    r->prev->next = r->next;
+  else
+    kmem.free[order] = r->next;
+  if(r->next)
+    r->next->prev = r->prev;
+  kmem.nblocks[order]--;
+  pgstate[PGNUM(r)] = 0;
+}
+
+// Free the block of 2^order pages at v, joining it with its
+// buddy for as long as that is free. Caller holds kmem.lock.
+static void
+buddyfree(char *v, int order)
+{
+  uint pn, b;
+
+  kmem.nfree += 1 << order;
+  pn = PGNUM(v);
+  for(; order < NORDER-1; order++){
+    b = pn ^ (1 << order);
+    if(b >= NPHYSPG || pgstate[b] != (PGFREE | order))
+      break;
+    blkremove(PNRUN(b), order);
+    pn &= ~(1 << order);
+  }
+  blkpush(PNRUN(pn), order);
+}
+
+// Allocate a block of 2^order pages, splitting the smallest
+// larger free block if there is none of that order. Return 0
+// if there is none big enough. Caller holds kmem.lock.
+static struct run*
+buddyalloc(int order)
+{
+  struct run *r;
+  int k;
+
+  for(k = order; k < NORDER && kmem.free[k] == 0; k++)
+    ;
+  if(k == NORDER)
+    return 0;
+  r = kmem.free[k];
+  blkremove(r, k);
+  // Free the upper half of what is left at each order.
+  while(k > order){
+    k--;
+    blkpush((struct run*)((char*)r + (PGSIZE << k)), k);
+  }
+  kmem.nfree -= 1 << order;
+  return r;
+}
+
+// Free the block of 2^order pages at v, which normally should
+// have been returned by kalloc_pages(order).
+void
+kfree_pages(char *v, int order)
+{
+  if(order == 0){
+    kfree(v);
+    return;
+  }
+  if(order < 0 || order >= NORDER ||
+     PGNUM(v) % (1 << order) || v < end || V2P(v) >= PHYSTOP)
+    panic("kfree_pages");
+
+  // Fill with junk to catch dangling refs.
+  memset(v, 1, PGSIZE << order);
+
+  acquire(&kmem.lock);
+  buddyfree(v, order);
+  release(&kmem.lock);
+}
+
+// Allocate 2^order physically contiguous pages, aligned to
+// their size. Returns a pointer that the kernel can use.
+// Returns 0 if there is no such block free.
+char*
+kalloc_pages(int order)
+{
+  struct run *r;
+
+  if(order == 0)
+    return kalloc();
+  if(order < 0 || order >= NORDER)
+    return 0;
+
+  acquire(&kmem.lock);
+  r = buddyalloc(order);
+  release(&kmem.lock);
+  return (char*)r;
+}
+
 // Free the page of physical memory pointed at by v,
 // which normally should have been returned by a
 // call to kalloc().  (The exception is when
@@ -59,21 +226,146 @@ freerange(void *vstart, void *vend)
 void
 kfree(char *v)
 {
-  struct run *r;
+  struct run *r, *batch;
+  struct kcache *kc;
+  int i;
 
   if((uint)v % PGSIZE || v < end || V2P(v) >= PHYSTOP)
     panic("kfree");
 
+  if(!kmem.use_lock){
+    memset(v, 1, PGSIZE);
+    buddyfree(v, 0);
+    return;
+  }
+
+  switch(xaddw(&pgref[PGNUM(v)], -1)){
+  case 0:
+    panic("kfree: not allocated");
+  case 1:
+    break;
+  default:
+    return;   // Still mapped elsewhere
+  }
+
   // Fill with junk to catch dangling refs.
   memset(v, 1, PGSIZE);
 
-  if(kmem.use_lock)
-    acquire(&kmem.lock);
   r = (struct run*)v;
-  r->next = kmem.freelist;
-  kmem.freelist = r;
-  if(kmem.use_lock)
+  pushcli();
+  kc = &kcache[cpuid()];
+  acquire(&kc->lock);
+  r->next = kc->freelist;
+  kc->freelist = r;
+  batch = 0;
+  if(++kc->n > KCACHE){
+    // Give the oldest KBATCH pages back.
+    for(i = 0; i < kc->n - KBATCH - 1; i++)
+      r = r->next;
+    batch = r->next;
+    r->next = 0;
+    kc->n -= KBATCH;
+  }
+  release(&kc->lock);
+  popcli();
+
+  if(batch){
+    acquire(&kmem.lock);
+    while((r = batch) != 0){
+      batch = r->next;
+      buddyfree((char*)r, 0);
+    }
     release(&kmem.lock);
+  }
+}
+
+// Take up to n pages from the front of list *lp and return
+// them as a list, setting *got to how many there were.
+static struct run*
+take(struct run **lp, int n, int *got)
+{
+  struct run *head, *r;
+  int i;
+
+  head = *lp;
+  if(head == 0){
+    *got = 0;
+    return 0;
+  }
+  r = head;
+  for(i = 1; i < n && r->next != 0; i++)
+    r = r->next;
+  *lp = r->next;
+  r->next = 0;
+  *got = i;
+  return head;
+}
+
+// Take up to KBATCH pages from the buddy system as a list,
+// setting *got to how many. Caller holds kmem.lock.
+static struct run*
+buddybatch(int *got)
+{
+  struct run *head, *r;
+  char *v;
+  int i;
+
+  head = 0;
+  if((v = (char*)buddyalloc(KBATCHORDER)) != 0){
+    for(i = KBATCH-1; i >= 0; i--){
+      r = (struct run*)(v + i*PGSIZE);
+      r->next = head;
+      head = r;
+    }
+    *got = KBATCH;
+    return head;
+  }
+  for(i = 0; i < KBATCH && (r = buddyalloc(0)) != 0; i++){
+    r->next = head;
+    head = r;
+  }
+  *got = i;
+  return head;
+}
+
+// Find free pages for cpu id's empty cache: a batch from the
+// buddy system, or else half the pages of another cpu's cache.
+// Return one and cache the rest.
+static struct run*
+refill(int id)
+{
+  struct kcache *kc, *other;
+  struct run *r, *rest, *tail;
+  int i, n;
+
+  acquire(&kmem.lock);
+  r = buddybatch(&n);
+  release(&kmem.lock);
+  for(i = 1; r == 0 && i < ncpu; i++){
+    other = &kcache[(id + i) % ncpu];
+    if(other->n == 0)
+      continue;
+    acquire(&other->lock);
+    r = take(&other->freelist, (other->n + 1) / 2, &n);
+    other->n -= n;
+    release(&other->lock);
+  }
+  if(r == 0)
+    return 0;
+
+  rest = r->next;
+  r->next = 0;
+  if(rest){
+    for(tail = rest; tail->next != 0; tail = tail->next)
+      ;
+    kc = &kcache[id];
+    acquire(&kc->lock);
+    tail->next = kc->freelist;
+    kc->freelist = rest;
+    kc->n += n - 1;
+    release(&kc->lock);
+  }
+  return r;
 }
 
 // Allocate one 4096-byte page of physical memory.
@@ -83,14 +375,62 @@ char*
 kalloc(void)
 {
   struct run *r;
+  struct kcache *kc;
 
-  if(kmem.use_lock)
-    acquire(&kmem.lock);
-  r = kmem.freelist;
+  if(!kmem.use_lock){
+    if((r = buddyalloc(0)) != 0)
+      pgref[PGNUM(r)] = 1;
+    return (char*)r;
+  }
+
+  pushcli();
+  kc = &kcache[cpuid()];
+  acquire(&kc->lock);
+  r = kc->freelist;
+  if(r){
+    kc->freelist = r->next;
+    kc->n--;
+  }
+  release(&kc->lock);
+  if(r == 0)
+    r = refill(cpuid());
+  popcli();
   if(r)
-    kmem.freelist = r->next;
-  if(kmem.use_lock)
-    release(&kmem.lock);
+    pgref[PGNUM(r)] = 1;
   return (char*)r;
 }
 
+// Count another page table mapping page v, from kalloc().
+void
+kref(char *v)
+{
+  xaddw(&pgref[PGNUM(v)], 1);
+}
+
+// Return the number of page tables mapping page v.
+int
+krefs(char *v)
+{
+  return pgref[PGNUM(v)];
+}
+
+// Report the free memory and how it is split up. The buddy
+// counts are a snapshot taken under kmem.lock, and the copy to
+// ms, which may be a user buffer, is made after releasing it.
+void
+meminfo(struct memstat *ms)
+{
+  struct memstat m;
+  int i;
+
+  acquire(&kmem.lock);
+  m.npages = kmem.npages;
+  m.nfree = kmem.nfree;
+  for(i = 0; i < NORDER; i++)
+    m.nblocks[i] = kmem.nblocks[i];
+  release(&kmem.lock);
+  m.ncached = 0;
+  for(i = 0; i < ncpu; i++)
+    m.ncached += kcache[i].n;
+  *ms = m;
+}
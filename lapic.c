@@ -113,6 +113,18 @@ lapiceoi(void)
     lapicw(EOI, 0);
 }
 
+// Send interrupt vector to the CPU with the given APIC ID.
+void
+lapicipi(int apicid, int vector)
+{
+  if(!lapic)
+    return;
+  lapicw(ICRHI, apicid<<24);
+  lapicw(ICRLO, FIXED | ASSERT | vector);
+  while(lapic[ICRLO] & DELIVS)
+    ;
+}
+
 // Spin for a given number of microseconds.
 // On real hardware would want to tune this dynamically.
 void
@@ -227,3 +239,69 @@ cmostime(struct rtcdate *r)
   *r = t1;
   r->year += 2000;
 }
+
+//PAGEBREAK!
+// The time-stamp counter gives the time in nanoseconds, for
+// precise accounting. Its rate is measured at boot against
+// channel 2 of the 8253 PIT, whose input clock is fixed, and
+// kept as tscmult, nanoseconds per cycle scaled by 2^TSCSHIFT,
+// so that converting cycles needs no division.
+#define PITHZ      1193182  // PIT input clock
+#define PIT_CH2    0x42     // Channel 2 counter
+#define PIT_MODE   0x43     // Mode/command register
+#define PIT_GATE   0x61     // Channel 2 gate and output
+#define CALLATCH   (PITHZ / 100)  // count to calibrate over, about 10ms
+#define CALNS      ((uint64)CALLATCH * 1000000000 / PITHZ)
+#define TSCSHIFT   20
+#define TSCMASK    ((1 << TSCSHIFT) - 1)
+
+static uint64 tscboot;  // TSC at calibration
+static uint tscmult;    // ns per cycle << TSCSHIFT, 0 if uncalibrated
+
+// Return n / d. Done with divl, one 32-bit half at a time
+// so that each quotient fits, since the kernel is not
+// linked with libgcc's 64-bit division.
+static uint64
+udiv64(uint64 n, uint d)
+{
+  uint qhi, qlo, r;
+
+  qhi = (uint)(n >> 32) / d;
+  r = (uint)(n >> 32) % d;
+  asm("divl %4" : "=a" (qlo), "=d" (r) : "0" ((uint)n), "1" (r), "rm" (d));
+  return (uint64)qhi << 32 | qlo;
+}
+
+// Measure the TSC rate. Called once, on the boot processor.
+void
+tscinit(void)
+{
+  uint64 t0, t1;
+  int i;
+
+  // Gate channel 2 on with the speaker off, and count down
+  // CALLATCH in mode 0, which raises the output at zero.
+  outb(PIT_GATE, (inb(PIT_GATE) & ~0x02) | 0x01);
+  outb(PIT_MODE, 0xB0);
+  outb(PIT_CH2, CALLATCH & 0xFF);
+  outb(PIT_CH2, CALLATCH >> 8);
+  t0 = rdtsc();
+  for(i = 0; (inb(PIT_GATE) & 0x20) == 0; i++)
+    if(i > 10000000)
+      return;  // no PIT: leave the clock at 0
+  t1 = rdtsc();
+  if(t1 - t0 == 0 || (t1 - t0) >> 32)
+    return;
+  tscmult = udiv64(CALNS << TSCSHIFT, t1 - t0);
+  tscboot = t1;
+}
+
+// Return nanoseconds since boot.
+uint64
+nsecs(void)
+{
+  uint64 c;
+
+  c = rdtsc() - tscboot;
+  return (c >> TSCSHIFT) * tscmult + (((c & TSCMASK) * tscmult) >> TSCSHIFT);
+}
@@ -0,0 +1,101 @@
+// Context switch latency benchmark.
+// Times a byte's round trip over a pair of pipes between two
+// processes, then a round trip of directed yields, where each
+// process hands the CPU straight to the other with yieldto().
+// Boot with make qemu CPUS=1 so that every round trip is a pair
+// of context switches.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define NROUND  10000  // default number of round trips
+#define USPERTICK 10000  // microseconds per timer tick
+
+// Print the time per round trip of n round trips
+// that took t ticks.
+void
+report(char *what, int n, int t)
+{
+  printf(1, "%s: %d round trips in %d ticks, %d us each\n",
+         what, n, t, t * USPERTICK / n);
+}
+
+void
+pipelat(int n)
+{
+  int ab[2], ba[2], i, t;
+  char c = 0;
+
+  if(pipe(ab) < 0 || pipe(ba) < 0){
+    printf(2, "latbench: pipe failed\n");
+    exit();
+  }
+  switch(fork()){
+  case -1:
+    printf(2, "latbench: fork failed\n");
+    exit();
+  case 0:
+    close(ab[1]);
+    close(ba[0]);
+    while(read(ab[0], &c, 1) == 1)
+      if(write(ba[1], &c, 1) != 1)
+        break;
+    exit();
+  }
+  close(ab[0]);
+  close(ba[1]);
+  t = uptime();
+  for(i = 0; i < n; i++){
+    if(write(ab[1], &c, 1) != 1 || read(ba[0], &c, 1) != 1){
+      printf(2, "latbench: pipe round trip failed\n");
+      break;
+    }
+  }
+  t = uptime() - t;
+  close(ab[1]);
+  close(ba[0]);
+  wait();
+  report("pipe", i, t);
+}
+
+void
+yieldlat(int n)
+{
+  int parent, child, i, t;
+
+  parent = getpid();
+  if((child = fork()) < 0){
+    printf(2, "latbench: fork failed\n");
+    exit();
+  }
+  if(child == 0){
+    for(;;)
+      yieldto(parent);
+  }
+  // yieldto() fails while the child is running elsewhere
+  // or has not been queued yet; only count the switches.
+  t = uptime();
+  for(i = 0; i < n; )
+    if(yieldto(child) == 0)
+      i++;
+  t = uptime() - t;
+  kill(child);
+  wait();
+  report("yieldto", n, t);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int n;
+
+  n = argc > 1 ? atoi(argv[1]) : NROUND;
+  if(n <= 0){
+    printf(2, "usage: latbench [rounds]\n");
+    exit();
+  }
+  pipelat(n);
+  yieldlat(n);
+  exit();
+}
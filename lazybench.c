@@ -0,0 +1,94 @@
+// Lazy heap benchmark.
+// Models a program that over-allocates: it mallocs a big heap
+// but only touches part of it. Reports how many pages of
+// physical memory that took, from the free page counts before
+// and after, and the time for a round of fork, malloc, touch,
+// exit and wait. sbrk() only reserves address space, so both
+// follow what is touched rather than what is allocated.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "memstat.h"
+
+#define HEAPKB    8192   // default heap size in KB
+#define TOUCHKB   256    // default part of it touched, in KB
+#define NROUND    50     // rounds timed
+#define PGSIZE    4096
+#define USPERTICK 10000  // microseconds per timer tick
+
+// Free pages, counting those the cpus have cached.
+int
+freepages(void)
+{
+  struct memstat ms;
+
+  if(meminfo(&ms) < 0){
+    printf(2, "lazybench: meminfo failed\n");
+    exit();
+  }
+  return ms.nfree + ms.ncached;
+}
+
+// Allocate heapkb KB and write to the first touchkb KB.
+// Return the heap, or 0 if out of memory.
+char*
+overallocate(int heapkb, int touchkb)
+{
+  char *heap;
+  int i;
+
+  if((heap = malloc(heapkb * 1024)) == 0)
+    return 0;
+  for(i = 0; i < touchkb * 1024; i += PGSIZE)
+    heap[i] = 1;
+  return heap;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int heapkb, touchkb, before, used, i, t, pid;
+
+  heapkb = argc > 1 ? atoi(argv[1]) : HEAPKB;
+  touchkb = argc > 2 ? atoi(argv[2]) : TOUCHKB;
+  if(heapkb <= 0 || touchkb < 0 || touchkb > heapkb){
+    printf(2, "usage: lazybench [heapkb] [touchkb]\n");
+    exit();
+  }
+
+  // Measure in a child, so the heap is gone again afterwards.
+  if((pid = fork()) < 0){
+    printf(2, "lazybench: fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    before = freepages();
+    if(overallocate(heapkb, touchkb) == 0){
+      printf(2, "lazybench: malloc failed\n");
+      exit();
+    }
+    used = before - freepages();
+    printf(1, "heap %d KB, touched %d KB: %d pages resident (%d KB)\n",
+           heapkb, touchkb, used, used * PGSIZE / 1024);
+    exit();
+  }
+  wait();
+
+  t = uptime();
+  for(i = 0; i < NROUND; i++){
+    if((pid = fork()) < 0){
+      printf(2, "lazybench: fork failed\n");
+      exit();
+    }
+    if(pid == 0){
+      overallocate(heapkb, touchkb);
+      exit();
+    }
+    wait();
+  }
+  t = uptime() - t;
+  printf(1, "%d rounds in %d ticks, %d us each\n",
+         NROUND, t, t * USPERTICK / NROUND);
+  exit();
+}
@@ -0,0 +1,36 @@
+// Report free physical memory and its fragmentation.
+// For each block order, prints the number of free blocks and
+// the share of free memory in smaller blocks, which is memory
+// that can't be used for an allocation of that order.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "memstat.h"
+
+int
+main(int argc, char *argv[])
+{
+  struct memstat ms;
+  int i, avail, largest;
+
+  if(meminfo(&ms) < 0){
+    printf(2, "memstat: meminfo failed\n");
+    exit();
+  }
+
+  printf(1, "pages %d, free %d, cached %d\n", ms.npages, ms.nfree, ms.ncached);
+  printf(1, "order\tkb\tblocks\tunusable\n");
+  avail = ms.nfree;
+  largest = -1;
+  for(i = 0; i < NORDER; i++){
+    printf(1, "%d\t%d\t%d\t%d%%\n", i, 4 << i, ms.nblocks[i],
+           ms.nfree > 0 ? (ms.nfree - avail) * 100 / ms.nfree : 0);
+    avail -= ms.nblocks[i] << i;
+    if(ms.nblocks[i] > 0)
+      largest = i;
+  }
+  if(largest >= 0)
+    printf(1, "largest free block %d kb\n", 4 << largest);
+  exit();
+}
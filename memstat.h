@@ -0,0 +1,8 @@
+#define NORDER 11  // Block orders, 1 to 1024 pages (kalloc_pages)
+
+struct memstat {
+  int npages;          // Pages of physical memory the kernel manages
+  int nfree;           // Free pages on the buddy lists
+  int ncached;         // Free pages cached by the cpus
+  int nblocks[NORDER]; // Free blocks of 2^order pages
+};
@@ -95,6 +95,11 @@ struct segdesc {
 #define PTE_W           0x002   // Writeable
 #define PTE_U           0x004   // User
 #define PTE_PS          0x080   // Page Size
+#define PTE_COW         0x200   // Copy-on-write (a bit left to software)
+
+// Page fault error code bits
+#define FEC_PR          0x001   // Page was present (protection fault)
+#define FEC_WR          0x002   // Fault was caused by a write
 
 // Address in page table or page directory entry
 #define PTE_ADDR(pte)   ((uint)(pte) & ~0xFFF)
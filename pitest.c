@@ -0,0 +1,127 @@
+// Priority inversion test for sleep locks.
+// A low priority reader keeps a file's inode locked while it
+// reads the file, which is bigger than the buffer cache, so the
+// lock is held across disk reads. Medium priority hogs then take
+// every cpu, and a high priority process fstat()s the file, which
+// needs the same inode lock. Without priority inheritance the
+// reader can't run until the hogs finish, so neither can the high
+// priority process; with it the reader runs at the waiter's
+// priority and the wait is short. Runs under PBS.
+
+#include "param.h"
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+#include "sched.h"
+#include "cpustat.h"
+
+#define FILESIZE (128*512)  // bigger than the buffer cache
+#define HOGTICKS 300        // how long the hogs run
+#define NROUND   10         // fstat()s timed
+#define LOWPRI   90
+#define MIDPRI   50
+#define HIGHPRI  10
+
+char buf[FILESIZE];
+struct cpustat cs[NCPU];
+char *file = "pitest.tmp";
+
+// Read the whole file over and over at low priority.
+void
+reader(void)
+{
+  int fd;
+
+  setpriority(LOWPRI, getpid());
+  for(;;){
+    if((fd = open(file, O_RDONLY)) < 0)
+      exit();
+    read(fd, buf, FILESIZE);
+    close(fd);
+  }
+}
+
+// Spin at medium priority until the deadline.
+void
+hog(uint end)
+{
+  setpriority(MIDPRI, getpid());
+  while(uptime() < end)
+    ;
+  exit();
+}
+
+int
+main(int argc, char *argv[])
+{
+  int fd, old, ncpu, rpid, i, w, max, total;
+  struct stat st;
+  uint end;
+
+  if((fd = open(file, O_CREATE|O_RDWR)) < 0){
+    printf(2, "pitest: cannot create %s\n", file);
+    exit();
+  }
+  if(write(fd, buf, FILESIZE) != FILESIZE){
+    printf(2, "pitest: write failed\n");
+    exit();
+  }
+  close(fd);
+  if((fd = open(file, O_RDONLY)) < 0){
+    printf(2, "pitest: cannot open %s\n", file);
+    exit();
+  }
+
+  old = schedctl(SCHED_PBS);
+  ncpu = cpuinfo(cs);
+  setpriority(HIGHPRI, getpid());
+
+  if((rpid = fork()) < 0){
+    printf(2, "pitest: fork failed\n");
+    exit();
+  }
+  if(rpid == 0)
+    reader();
+  sleep(10);
+
+  end = uptime() + HOGTICKS;
+  for(i = 0; i < ncpu; i++){
+    w = fork();
+    if(w < 0){
+      printf(2, "pitest: fork failed\n");
+      exit();
+    }
+    if(w == 0)
+      hog(end);
+  }
+
+  // The hogs now keep the reader off the cpus, most likely
+  // with the inode locked.
+  max = 0;
+  total = 0;
+  for(i = 0; i < NROUND; i++){
+    sleep(2);
+    w = uptime();
+    fstat(fd, &st);
+    w = uptime() - w;
+    total += w;
+    if(w > max)
+      max = w;
+  }
+
+  kill(rpid);
+  for(i = 0; i < ncpu + 1; i++)
+    wait();
+  close(fd);
+  unlink(file);
+  schedctl(old);
+
+  printf(1, "%d hogs for %d ticks: fstat waited %d ticks at most, %d in all\n",
+         ncpu, HOGTICKS, max, total);
+  if(max >= HOGTICKS / 2)
+    printf(1, "pitest: priority inversion\n");
+  else
+    printf(1, "pitest ok\n");
+  exit();
+}
@@ -4,19 +4,73 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "x86.h"
-#include "proc.h"
+#include "traps.h"
 #include "spinlock.h"
+#include "proc.h"
 #include "procstat.h"
-
+#include "cpustat.h"
+#include "sched.h"
+#include "slab.h"
+
+// Locking. Each process has its own lock, p->lock, which protects
+// p->state and p->chan and is held across the switch to and from the
+// process, so that only one cpu runs a process and wakeups can't
+// slip in while it is on its way to sleep. Other locks:
+//   ptable.lock: allocation, the pid hash and parent/child links.
+//   sleepq[].lock: each wait queue.
+//   cpus[i].rq.lock: cpu i's own run queue, under a percpu policy
+//     (RR), and p->onrq of the processes on it.
+//   rqlock: the run queues a policy shares between cpus, p->onrq
+//     of the processes on them, and the real-time class.
+// See lockrq() for which one covers a process.
+// They are taken in this order: ptable.lock, a wait queue's lock,
+// p->lock, rqlock, the cpus' run queue locks in cpu order. A
+// process lock is only taken while holding another one by sched(),
+// with tryacquire(), when it switches from one process straight
+// to the next.
+//
+// The process table. struct procs are allocated on demand from an
+// object cache, and kept on a list in pid order while in use. Freed
+// ones are cached on a free list for the next fork rather than
+// given back to the cache, so a struct proc stays valid memory once
+// allocated.
 struct {
   struct spinlock lock;
-  struct proc proc[NPROC];
+  struct proc *head;    // Allocated processes, oldest pid first
+  struct proc *tail;    // Most recently allocated process
+  struct proc *free;    // UNUSED struct procs ready for reuse
 } ptable;
 
-struct {
-  int tail;
-  struct proc* proc[NPROC];
-} queue[NQUEUE];
+static struct slabcache proccache;
+
+static struct spinlock rqlock;
+
+// Real-time (EDF) processes, on a list threaded through
+// proc->rtnext. Protected by rqlock. rtutil is their total
+// utilization in per-mille, which admission keeps within one CPU.
+// nrtready counts those that are waiting to run with budget left,
+// and may be read without the lock.
+static struct proc *rtlist;
+static int rtutil;
+static volatile int nrtready;
+
+// Processes in sleep(), on wait queues threaded through
+// proc->slnext and proc->slprev in the order they went to
+// sleep. A process sleeping on chan is on the queue chanhash()
+// picks, so wakeup() only looks at the processes that hash
+// there. Each queue has its own lock.
+#define NSLEEPQ 64
+static struct sleepq {
+  struct spinlock lock;
+  struct proc *head;
+  struct proc *tail;
+} sleepq[NSLEEPQ];
+
+// Processes that have a pid, hashed by it into chains threaded
+// through proc->pidnext, so that findproc() needn't scan ptable.
+// Protected by ptable.lock.
+#define NPIDHASH 1024
+static struct proc *pidhash[NPIDHASH];
 
 static struct proc *initproc;
 
@@ -24,22 +78,153 @@ int nextpid = 1;
 extern void forkret(void);
 extern void trapret(void);
 
-static void wakeup1(void *chan);
+static void ready(struct proc *p);
+static void kick(struct proc *p);
+static void rtleave(struct proc *p);
 
-void
-pinit(void)
+// Fibonacci hashing of the channel address: multiply by 2^32
+// over the golden ratio and keep the top log2(NSLEEPQ) bits.
+static uint
+chanhash(void *chan)
 {
-  initlock(&ptable.lock, "ptable");
+  return ((uint)chan * 2654435769U) >> 26;
 }
 
-void
-qinit(void)
+// Put p at the tail of the wait queue for its chan.
+// The queue's lock must be held.
+static void
+sleepenq(struct proc *p)
+{
+  uint h = chanhash(p->chan);
+
+  p->slnext = 0;
+  p->slprev = sleepq[h].tail;
+  if(sleepq[h].tail)
+    sleepq[h].tail->slnext = p;
+  else
+    sleepq[h].head = p;
+  sleepq[h].tail = p;
+}
+
+// Take the SLEEPING process p off its wait queue and
+// make it RUNNABLE. The queue's lock and p->lock must be held.
+static void
+unsleep(struct proc *p)
+{
+  uint h = chanhash(p->chan);
+
+  if(p->slprev)
+    p->slprev->slnext = p->slnext;
+  else
+    sleepq[h].head = p->slnext;
+  if(p->slnext)
+    p->slnext->slprev = p->slprev;
+  else
+    sleepq[h].tail = p->slprev;
+  p->slnext = 0;
+  p->slprev = 0;
+  ready(p);
+}
+
+// Return the process with the given pid, or 0.
+// The ptable lock must be held.
+static struct proc*
+findproc(int pid)
+{
+  struct proc *p;
+
+  if(pid <= 0)
+    return 0;
+  for(p = pidhash[pid % NPIDHASH]; p != 0; p = p->pidnext)
+    if(p->pid == pid)
+      return p;
+  return 0;
+}
+
+static void
+procctor(void *v)
+{
+  struct proc *p = v;
+
+  memset(p, 0, sizeof(*p));
+  initlock(&p->lock, "proc");
+}
+
+// Take a struct proc from the free list, or from the cache if
+// it is empty, and put it at the tail of the process table.
+// Return 0 if out of memory.
+// The ptable lock must be held.
+static struct proc*
+procalloc(void)
+{
+  struct proc *p;
+
+  if((p = ptable.free) != 0)
+    ptable.free = p->allnext;
+  else if((p = slaballoc(&proccache)) == 0)
+    return 0;
+
+  p->allnext = 0;
+  p->allprev = ptable.tail;
+  if(ptable.tail)
+    ptable.tail->allnext = p;
+  else
+    ptable.head = p;
+  ptable.tail = p;
+  return p;
+}
+
+// Give p back to the free list, taking it off the process table,
+// the pid hash and its parent's children.
+// The ptable lock must be held.
+static void
+freeproc(struct proc *p)
 {
-  for(int i = 0; i < NQUEUE; i++){
-    queue[i].tail = 0;
-    for(int j = 0; j < NPROC; j++)
-      queue[i].proc[j] = 0;
+  struct proc **pp;
+
+  for(pp = &pidhash[p->pid % NPIDHASH]; *pp != 0; pp = &(*pp)->pidnext)
+    if(*pp == p){
+      *pp = p->pidnext;
+      break;
+    }
+  if(p->parent){
+    for(pp = &p->parent->children; *pp != 0; pp = &(*pp)->sibling)
+      if(*pp == p){
+        *pp = p->sibling;
+        break;
+      }
   }
+  p->pidnext = 0;
+  p->sibling = 0;
+  p->pid = 0;
+  p->parent = 0;
+  p->name[0] = 0;
+  p->killed = 0;
+  p->state = UNUSED;
+
+  if(p->allprev)
+    p->allprev->allnext = p->allnext;
+  else
+    ptable.head = p->allnext;
+  if(p->allnext)
+    p->allnext->allprev = p->allprev;
+  else
+    ptable.tail = p->allprev;
+  p->allprev = 0;
+  p->allnext = ptable.free;
+  ptable.free = p;
+}
+
+void
+pinit(void)
+{
+  initlock(&ptable.lock, "ptable");
+  slabinit(&proccache, "proc", sizeof(struct proc), procctor);
+  initlock(&rqlock, "runq");
+  for(int i = 0; i < NCPU; i++)
+    initlock(&cpus[i].rq.lock, "cpurunq");
+  for(int i = 0; i < NSLEEPQ; i++)
+    initlock(&sleepq[i].lock, "sleepq");
 }
 
 // Must be called with interrupts disabled
@@ -82,10 +267,9 @@ myproc(void) {
 }
 
 //PAGEBREAK: 32
-// Look in the process table for an UNUSED proc.
-// If found, change state to EMBRYO and initialize
-// state required to run in the kernel.
-// Otherwise return 0.
+// Allocate a proc, change its state to EMBRYO and
+// initialize state required to run in the kernel.
+// Return 0 if out of memory.
 static struct proc*
 allocproc(void)
 {
@@ -94,22 +278,25 @@ allocproc(void)
 
   acquire(&ptable.lock);
 
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    if(p->state == UNUSED)
-      goto found;
-
-  release(&ptable.lock);
-  return 0;
-
-found:
+  if((p = procalloc()) == 0){
+    release(&ptable.lock);
+    return 0;
+  }
   p->state = EMBRYO;
   p->pid = nextpid++;
+  p->parent = 0;
+  p->children = 0;
+  p->sibling = 0;
+  p->pidnext = pidhash[p->pid % NPIDHASH];
+  pidhash[p->pid % NPIDHASH] = p;
 
   release(&ptable.lock);
 
   // Allocate kernel stack.
   if((p->kstack = kalloc()) == 0){
-    p->state = UNUSED;
+    acquire(&ptable.lock);
+    freeproc(p);
+    release(&ptable.lock);
     return 0;
   }
   sp = p->kstack + KSTACKSIZE;
@@ -118,7 +305,15 @@ found:
   p->ctime = ticks;
   p->rtime = 0;
   p->etime = 0;
+  p->ctimens = nsecs();
+  p->etimens = 0;
+  p->rtimens = 0;
+  p->waitns = 0;
   p->priority = 60;
+  p->basepriority = 60;
+  p->held = 0;
+  p->blockedon = 0;
+  p->pinext = 0;
   p->ntimes = 0;
   p->queue = 0;
   p->timeslice = 0;
@@ -126,6 +321,20 @@ found:
     p->ticks[i] = 0;
   p->lastref = ticks;
   p->qtime = 0;
+  p->demote = 0;
+  p->onrq = 0;
+  p->rqnext = 0;
+  p->rqprev = 0;
+  p->lastcpu = 0;
+  p->rqcpu = 0;
+  p->affinity = ~0;
+  p->nmigrate = 0;
+  p->vruntime = 0;
+  p->tickets = 100;
+  p->pass = 0;
+  p->rtperiod = 0;
+  p->rtmisses = 0;
+  p->rtnext = 0;
 
   // Leave room for trap frame.
   sp -= sizeof *p->tf;
@@ -175,13 +384,11 @@ userinit(void)
   // run this process. the acquire forces the above
   // writes to be visible, and the lock is also needed
   // because the assignment might not be atomic.
-  acquire(&ptable.lock);
+  acquire(&p->lock);
 
-  p->state = RUNNABLE;
-#ifdef MLFQ
-  addproc(p, 0);
-#endif
-  release(&ptable.lock);
+  ready(p);
+
+  release(&p->lock);
 }
 
 // Grow current process's memory by n bytes.
@@ -194,8 +401,11 @@ growproc(int n)
 
   sz = curproc->sz;
   if(n > 0){
-    if((sz = allocuvm(curproc->pgdir, sz, sz + n)) == 0)
+    // Only reserve the address space: lazyfault() allocates
+    // each page when it is first touched.
+    if(sz + n >= KERNBASE || sz + n < sz)
       return -1;
+    sz += n;
   } else if(n < 0){
     if((sz = deallocuvm(curproc->pgdir, sz, sz + n)) == 0)
       return -1;
@@ -224,11 +434,16 @@ fork(void)
   if((np->pgdir = copyuvm(curproc->pgdir, curproc->sz)) == 0){
     kfree(np->kstack);
     np->kstack = 0;
-    np->state = UNUSED;
+    acquire(&ptable.lock);
+    freeproc(np);
+    release(&ptable.lock);
     return -1;
   }
   np->sz = curproc->sz;
-  np->parent = curproc;
+  np->vruntime = curproc->vruntime;
+  np->tickets = curproc->tickets;
+  np->affinity = curproc->affinity;
+  np->pass = curproc->pass;
   *np->tf = *curproc->tf;
 
   // Clear %eax so that fork returns 0 in the child.
@@ -245,12 +460,20 @@ fork(void)
 
   acquire(&ptable.lock);
 
-  np->state = RUNNABLE;
-#ifdef MLFQ
-  addproc(np, 0);
-#endif
+  np->parent = curproc;
+  np->sibling = curproc->children;
+  curproc->children = np;
+
   release(&ptable.lock);
 
+  acquire(&np->lock);
+
+  // Start the child on this cpu; an idle cpu will steal it.
+  np->lastcpu = cpuid();
+  ready(np);
+
+  release(&np->lock);
+
   return pid;
 }
 
@@ -280,58 +503,80 @@ exit(void)
   end_op();
   curproc->cwd = 0;
   curproc->etime = ticks;
+  curproc->etimens = nsecs();
 
   acquire(&ptable.lock);
 
+  acquire(&rqlock);
+  rtleave(curproc);
+  release(&rqlock);
+
   // Parent might be sleeping in wait().
-  wakeup1(curproc->parent);
+  wakeup(curproc->parent);
 
   // Pass abandoned children to init.
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->parent == curproc){
+  if((p = curproc->children) != 0){
+    for(;;){
       p->parent = initproc;
       if(p->state == ZOMBIE)
-        wakeup1(initproc);
+        wakeup(initproc);
+      if(p->sibling == 0)
+        break;
+      p = p->sibling;
     }
+    p->sibling = initproc->children;
+    initproc->children = curproc->children;
+    curproc->children = 0;
   }
 
-  // Jump into the scheduler, never to return.
+  // Jump into the scheduler, never to return. wait() sees the
+  // ZOMBIE state under ptable.lock, and takes curproc->lock
+  // before freeing the stack we are still running on.
+  acquire(&curproc->lock);
   curproc->state = ZOMBIE;
+  release(&ptable.lock);
   sched();
   panic("zombie exit");
 }
 
 // Wait for a child process to exit and return its pid.
+// Store its run time and wait time through the pointers that
+// are not null, in ticks and in nanoseconds.
 // Return -1 if this process has no children.
-int
-wait(void)
+static int
+waitany(int *wtime, int *rtime, uint64 *wtimens, uint64 *rtimens)
 {
   struct proc *p;
   int havekids, pid;
+  uint64 total;
   struct proc *curproc = myproc();
   
   acquire(&ptable.lock);
   for(;;){
-    // Scan through table looking for exited children.
-    havekids = 0;
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->parent != curproc)
-        continue;
-      havekids = 1;
+    // Scan through our children looking for exited ones.
+    havekids = curproc->children != 0;
+    for(p = curproc->children; p != 0; p = p->sibling){
       if(p->state == ZOMBIE){
         // Found one.
         pid = p->pid;
+        acquire(&p->lock);  // wait for it to leave the cpu
+        release(&p->lock);
+        // Waiting time is total time - run time.
+        if(rtime){
+          *rtime = p->rtime;
+          *wtime = (p->etime - p->ctime) - p->rtime;
+        }
+        if(rtimens){
+          // The last stretch of run time is charged in sched(),
+          // after etimens was taken.
+          total = p->etimens - p->ctimens;
+          *rtimens = p->rtimens;
+          *wtimens = total > p->rtimens ? total - p->rtimens : 0;
+        }
         kfree(p->kstack);
         p->kstack = 0;
         freevm(p->pgdir);
-#ifdef MLFQ
-        removeproc(p,p->queue);
-#endif
-        p->pid = 0;
-        p->parent = 0;
-        p->name[0] = 0;
-        p->killed = 0;
-        p->state = UNUSED;
+        freeproc(p);
         release(&ptable.lock);
         return pid;
       }
@@ -343,85 +588,376 @@ wait(void)
       return -1;
     }
 
-    // Wait for children to exit.  (See wakeup1 call in proc_exit.)
+    // Wait for children to exit.  (See wakeup call in proc_exit.)
     sleep(curproc, &ptable.lock);  //DOC: wait-sleep
   }
 }
 
+// Wait for a child process to exit and return its pid.
+// Return -1 if this process has no children.
+int
+wait(void)
+{
+  return waitany(0, 0, 0, 0);
+}
+
 // Waits for a child process to exit,
 // Additionaly stores the saved runtime and wait time of the child process 
 // Return -1 if this process has no chidren
 int
 waitx(int *wtime, int *rtime)
 {
-  struct proc *p;
-  int havekids, pid;
-  struct proc *curproc = myproc();
-  
-  acquire(&ptable.lock);
-  for(;;){
-    // Scan through table looking for exited children.
-    havekids = 0;
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->parent != curproc)
-        continue;
-      havekids = 1;
-      if(p->state == ZOMBIE){
-        // Found one.
-        pid = p->pid;
-        *rtime = p->rtime;
-        // Set waiting time to be total time - run time
-        *wtime = (p->etime - p->ctime) - p->rtime;
-        kfree(p->kstack);
-        p->kstack = 0;
-        freevm(p->pgdir);
-#ifdef MLFQ
-        removeproc(p,p->queue);
-#endif
-        p->pid = 0;
-        p->parent = 0;
-        p->name[0] = 0;
-        p->killed = 0;
-        p->state = UNUSED;
-        release(&ptable.lock);
-        return pid;
-      }
+  return waitany(wtime, rtime, 0, 0);
+}
+
+// Like waitx, but with the times in nanoseconds.
+int
+waitxns(uint64 *wtime, uint64 *rtime)
+{
+  return waitany(0, 0, wtime, rtime);
+}
+
+//PAGEBREAK: 30
+// Real-time processes are scheduled earliest deadline first,
+// ahead of every other class. Each has a period, a runtime and a
+// relative deadline: every period a new job is released with a
+// budget of runtime ticks, and it should finish (by calling
+// rtwait()) within deadline ticks of its release. A process that
+// uses up its budget is throttled until its next release.
+
+// Absolute deadline of p's current job.
+static uint
+rtdue(struct proc *p)
+{
+  return p->rtrelease + p->rtdeadline;
+}
+
+// Return the waiting real-time process with budget left and the
+// earliest deadline that may run on cpu c, or 0.
+// rqlock must be held.
+static struct proc*
+edfpick(struct cpu *c)
+{
+  struct proc *p, *best;
+
+  best = 0;
+  for(p = rtlist; p != 0; p = p->rtnext){
+    if(!p->onrq || p->rtbudget <= 0 || !cpuok(p, c))
+      continue;
+    if(best == 0 || (int)(rtdue(p) - rtdue(best)) < 0)
+      best = p;
+  }
+  return best;
+}
+
+// Take p out of the real-time class.
+// rqlock must be held.
+static void
+rtleave(struct proc *p)
+{
+  struct proc **pp;
+
+  if(p->rtperiod == 0)
+    return;
+  for(pp = &rtlist; *pp != 0; pp = &(*pp)->rtnext)
+    if(*pp == p){
+      *pp = p->rtnext;
+      break;
     }
+  p->rtnext = 0;
+  rtutil -= p->rtutil;
+  p->rtperiod = 0;
+}
 
-    // No point waiting if we don't have any children.
-    if(!havekids || curproc->killed){
-      release(&ptable.lock);
+// Put the current process in the real-time class with the given
+// period, runtime and relative deadline (0 means the period), or
+// take it out if period is 0. Return -1 if the parameters are
+// invalid or admitting it would use more than one CPU in total.
+int
+setrt(int period, int runtime, int deadline)
+{
+  struct proc *p = myproc();
+  int util;
+
+  if(deadline == 0)
+    deadline = period;
+  if(period < 0 || (period > 0 && (runtime <= 0 ||
+     runtime > deadline || deadline > period)))
+    return -1;
+
+  acquire(&rqlock);
+  if(period == 0){
+    rtleave(p);
+    release(&rqlock);
+    return 0;
+  }
+  // Round up so that admitted utilization is never understated.
+  util = (runtime * 1000 + period - 1) / period;
+  if(rtutil - (p->rtperiod ? p->rtutil : 0) + util > 1000){
+    release(&rqlock);
+    return -1;
+  }
+  if(p->rtperiod == 0){
+    p->rtnext = rtlist;
+    rtlist = p;
+  } else
+    rtutil -= p->rtutil;
+  rtutil += util;
+  p->rtutil = util;
+  p->rtperiod = period;
+  p->rtruntime = runtime;
+  p->rtdeadline = deadline;
+  p->rtrelease = ticks;
+  p->rtbudget = runtime;
+  p->rtdone = 0;
+  p->rtlate = 0;
+  release(&rqlock);
+  return 0;
+}
+
+// Finish the current real-time job and sleep until the next
+// one is released. Return the release time of the new job,
+// or -1 if not a real-time process or killed.
+int
+rtwait(void)
+{
+  struct proc *p = myproc();
+  uint when;
+  int t;
+
+  acquire(&rqlock);
+  if(p->rtperiod == 0){
+    release(&rqlock);
+    return -1;
+  }
+  p->rtdone = 1;
+  while(p->rtdone){
+    // rttick() releases the next job before the
+    // timers for that tick run.
+    when = p->rtrelease + p->rtperiod;
+    release(&rqlock);
+    if(sleepuntil(when) < 0)
       return -1;
+    acquire(&rqlock);
+  }
+  t = p->rtrelease;
+  release(&rqlock);
+  return t;
+}
+
+// Count missed deadlines and release new jobs of the real-time
+// processes. Called by cpu 0 on every tick.
+void
+rttick(void)
+{
+  struct proc *p;
+
+  if(rtlist == 0)
+    return;
+  acquire(&rqlock);
+  for(p = rtlist; p != 0; p = p->rtnext){
+    if(!p->rtdone && !p->rtlate && (int)(ticks - rtdue(p)) >= 0){
+      p->rtlate = 1;
+      p->rtmisses++;
     }
+    if(ticks - p->rtrelease < p->rtperiod)
+      continue;
+    // Release the next job, skipping any periods that were
+    // missed completely.
+    while(ticks - p->rtrelease >= p->rtperiod)
+      p->rtrelease += p->rtperiod;
+    if(p->onrq && p->rtbudget <= 0){
+      nrtready++;  // no longer throttled
+      kick(p);
+    }
+    p->rtbudget = p->rtruntime;
+    p->rtdone = 0;
+    p->rtlate = 0;
+  }
+  release(&rqlock);
+}
 
-    // Wait for children to exit.  (See wakeup1 call in proc_exit.)
-    sleep(curproc, &ptable.lock);  //DOC: wait-sleep
+// Should the process running p give up the CPU on this tick?
+// True if p is real-time and has used up its budget or an earlier
+// deadline is ready, or if p is not real-time and any real-time
+// job is ready.
+static int
+rtpreempt(struct proc *p)
+{
+  struct proc *q;
+  int r;
+
+  if(p->rtperiod == 0 && nrtready == 0)
+    return 0;
+  acquire(&rqlock);
+  q = edfpick(mycpu());
+  if(p->rtperiod)
+    r = p->rtbudget <= 0 || (q != 0 && (int)(rtdue(q) - rtdue(p)) < 0);
+  else
+    r = q != 0;
+  release(&rqlock);
+  return r;
+}
+
+// Should the running process p give up the CPU on this tick?
+int
+preempt(struct proc *p)
+{
+  if(p->rtperiod)
+    return rtpreempt(p);
+  return rtpreempt(p) || policy->yield(p);
+}
+
+// Lock the run queue that p is on, or if queue is set the one it
+// is to be queued on, and return the lock: rqlock for a real-time
+// process or a policy that shares its queues, else the lock of a
+// cpu's own queue. schedctl() holds every run queue lock while it
+// changes the policy, so the policy can't change while this one
+// is held.
+static struct spinlock*
+lockrq(struct proc *p, int queue)
+{
+  struct schedops *ops;
+  struct spinlock *lk;
+  int cpu;
+
+  for(;;){
+    ops = policy;
+    cpu = queue ? homecpu(p) : p->rqcpu;
+    if(p->rtperiod || !ops->percpu)
+      lk = &rqlock;
+    else
+      lk = &cpus[cpu].rq.lock;
+    acquire(lk);
+    // Try again if the policy changed, or p was moved to
+    // another cpu's queue, while we waited.
+    if(ops == policy && (lk == &rqlock || queue || p->rqcpu == cpu))
+      return lk;
+    release(lk);
   }
 }
 
-// Update the time of each running process with every tick of CPU
-void 
-updatetime(void)
+// Lock the run queue cpu c picks from, and return the lock:
+// c's own under a percpu policy, else rqlock.
+static struct spinlock*
+lockcpu(struct cpu *c)
+{
+  struct schedops *ops;
+  struct spinlock *lk;
+
+  for(;;){
+    ops = policy;
+    lk = ops->percpu ? &c->rq.lock : &rqlock;
+    acquire(lk);
+    if(ops == policy)
+      return lk;
+    release(lk);
+  }
+}
+
+// Switch to scheduling policy id, moving every queued process
+// over to the new policy's run queues.
+// Return -1 if id is not a policy
+// Else Return the id of the old policy, or of the current
+// one if id is negative
+int
+schedctl(int id)
 {
   struct proc *p;
+  struct cpu *c;
+  int old;
+
+  if(id < 0)
+    return policy->id;
+  if(id >= NSCHED)
+    return -1;
+
   acquire(&ptable.lock);
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->state == RUNNING){
-      p->rtime++;
-      p->timeslice++;
-#ifdef MLFQ
-      if(p->timeslice >= qpriority(p->queue)){
-        p->ticks[p->queue]++;
-      }
-      // cprintf("[%d] [%d] timeslice _%d_ in _%d_\n", 
-      //         ticks, p->pid, p->timeslice, p->queue);
-#endif 
-    }
+  acquire(&rqlock);
+  for(c = cpus; c < cpus+ncpu; c++)
+    acquire(&c->rq.lock);
+  old = policy->id;
+  for(p = ptable.head; p != 0; p = p->allnext){
+    p->demote = 0;
+    if(p->onrq && p->rtperiod == 0)
+      policy->dequeue(p);
   }
+  policy = schedops[id];
+  for(p = ptable.head; p != 0; p = p->allnext)
+    if(p->onrq && p->rtperiod == 0)
+      policy->enqueue(p);
+  for(c = cpus; c < cpus+ncpu; c++)
+    release(&c->rq.lock);
+  release(&rqlock);
   release(&ptable.lock);
+  return old;
+}
+
+// Charge the process running on this cpu for a tick.
+// Called by every cpu from its own timer interrupt, so it
+// needs no lock: only this cpu updates a running process's
+// times and policy counters. The real-time budget is shared
+// with rttick(), which refills it.
+void 
+updatetime(void)
+{
+  struct proc *p = myproc();
+
+  if(p == 0 || p->state != RUNNING)
+    return;
+  p->rtime++;
+  p->timeslice++;
+  if(p->rtperiod){
+    acquire(&rqlock);
+    p->rtbudget--;
+    release(&rqlock);
+  } else
+    policy->tick(p);
+}
+
+#define LOADEXP       2028  // FIXED1 * e^(-1/100): averages over ~100 ticks
+#define BALANCETICKS  8     // Ticks of a cpu between load balancing runs
+
+// Update this cpu's load average, and every BALANCETICKS of its
+// ticks let the policy pull work to it from busier cpus.
+// Called by every cpu from its own timer interrupt.
+void
+balance(void)
+{
+  struct cpu *c = mycpu();
+  struct spinlock *lk;
+  uint nr;
+
+  // Runnable here: the running process and this cpu's own
+  // run queue, which only per-cpu policies use.
+  nr = c->rq.len + (c->proc != 0);
+  c->loadavg = ((uint64)c->loadavg * LOADEXP +
+                (uint64)(nr << FSHIFT) * (FIXED1 - LOADEXP)) >> FSHIFT;
+
+  if(ncpu == 1 || policy->balance == 0 ||
+     (c->busyticks + c->idleticks) % BALANCETICKS != 0)
+    return;
+  lk = lockcpu(c);
+  if(policy->balance)
+    policy->balance(c);
+  release(lk);
+}
+
+// Change p's priority, moving it between the policy's run
+// queues if it is queued and they are kept by priority.
+// Caller holds the lock of p's run queue, see lockrq().
+static void
+setprio(struct proc *p, int priority)
+{
+  if(p->onrq && p->rtperiod == 0 && policy->setpriority)
+    policy->setpriority(p, priority);
+  else
+    p->priority = priority;
 }
 
-// Set the priority of a given process
+// Set the priority of a given process. A process whose priority
+// was raised by a waiter for a sleep lock it holds keeps the
+// raised priority until it releases the lock.
 // Return -1 if no pid found
 // Else Return old priority
 int
@@ -430,21 +966,21 @@ setpriority(int priority, int pid)
   if(priority < 0 || priority > 100) 
     return -1;
   struct proc *p;
-  int old = -1;
+  struct spinlock *lk;
+  int old;
 
   acquire(&ptable.lock);
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    if(p->pid == pid){
-      old = p->priority;
-      p->priority = priority;
-      release(&ptable.lock);
-      break;
-    }
-
-  if(old < 0){
+  if((p = findproc(pid)) == 0){
     release(&ptable.lock);
     return -1;
   }
+  lk = lockrq(p, 0);
+  old = p->basepriority;
+  if(p->priority == p->basepriority || priority < p->priority)
+    setprio(p, priority);
+  p->basepriority = priority;
+  release(lk);
+  release(&ptable.lock);
   
   if(old > priority)
     yield();
@@ -452,45 +988,248 @@ setpriority(int priority, int pid)
   return old;
 }
 
-// Add process to a new queue
+// Lend p the priority of a process waiting for a sleep lock
+// that p holds, if it is better than p's own. Return 1 if
+// p's priority went up.
+int
+lendpriority(struct proc *p, int priority)
+{
+  struct spinlock *lk;
+  int r = 0;
+
+  lk = lockrq(p, 0);
+  if(priority < p->priority){
+    setprio(p, priority);
+    r = 1;
+  }
+  release(lk);
+  return r;
+}
+
+// Take back what was lent to p: drop its priority to its own,
+// or to priority if that is still better.
 void
-addproc(struct proc *p, int id)
-{ 
-  if(id < 0 || id > 4)
+restorepriority(struct proc *p, int priority)
+{
+  struct spinlock *lk;
+
+  lk = lockrq(p, 0);
+  if(priority > p->basepriority)
+    priority = p->basepriority;
+  if(priority != p->priority)
+    setprio(p, priority);
+  release(lk);
+}
+
+// Restrict a given process to the cpus in mask, bit i
+// standing for cpu i. It moves off a cpu it may no longer
+// use the next time it gives up the cpu, at once for the
+// calling process.
+// Return -1 if no pid found or mask has no cpu
+// Else Return old mask
+int
+setaffinity(int pid, int mask)
+{
+  struct proc *p;
+  struct spinlock *lk;
+  int old, move, requeue;
+
+  mask &= (1 << ncpu) - 1;
+  if(mask == 0)
+    return -1;
+
+  acquire(&ptable.lock);
+  if((p = findproc(pid)) == 0){
+    release(&ptable.lock);
+    return -1;
+  }
+  // p->lock keeps ready() from queueing p by the old mask.
+  acquire(&p->lock);
+  release(&ptable.lock);
+  lk = lockrq(p, 0);
+  old = p->affinity & ((1 << ncpu) - 1);
+  p->affinity = mask;
+  // Requeue it in case it waits on a cpu's own queue.
+  if((requeue = p->onrq && p->rtperiod == 0) != 0){
+    policy->dequeue(p);
+    p->onrq = 0;
+  }
+  release(lk);
+  if(requeue){
+    lk = lockrq(p, 1);
+    policy->enqueue(p);
+    p->onrq = 1;
+    release(lk);
+    kick(p);
+  }
+  release(&p->lock);
+
+  if(p == myproc()){
+    pushcli();
+    move = !cpuok(p, mycpu());
+    popcli();
+    if(move)
+      yield();
+  }
+  return old;
+}
+
+// Set the number of tickets of a given process,
+// which its children inherit.
+// Return -1 if no pid found
+// Else Return old number of tickets
+int
+settickets(int tickets, int pid)
+{
+  struct proc *p;
+  struct spinlock *lk;
+  int old;
+
+  if(tickets < 1 || tickets > MAXTICKETS)
+    return -1;
+
+  acquire(&ptable.lock);
+  if((p = findproc(pid)) == 0){
+    release(&ptable.lock);
+    return -1;
+  }
+  lk = lockrq(p, 0);
+  old = p->tickets;
+  p->tickets = tickets;
+  release(lk);
+  release(&ptable.lock);
+  return old;
+}
+
+// Mark p RUNNABLE and queue it for the scheduling policy.
+// p->lock must be held.
+static void
+ready(struct proc *p)
+{
+  struct spinlock *lk;
+  int wake;
+
+  p->state = RUNNABLE;
+  p->readyat = nsecs();
+  lk = lockrq(p, 1);
+  p->onrq = 1;
+  wake = 1;
+  if(p->rtperiod){
+    // Real-time processes are picked from rtlist.
+    if(p->rtbudget > 0)
+      nrtready++;
+    else
+      wake = 0;  // throttled until its next release
+  } else
+    policy->enqueue(p);
+  release(lk);
+  if(wake)
+    kick(p);
+}
+
+// Wake an idle cpu that may run p, which has just been
+// queued, preferring the cpu p last ran on. Nothing to do if
+// this cpu is idle and may run p, since it will find p once
+// the interrupt it is handling returns.
+static void
+kick(struct proc *p)
+{
+  struct cpu *c;
+
+  if(mycpu()->idle && cpuok(p, mycpu()))
     return;
-  if(queue[id].proc[queue[id].tail] != 0 || queue[id].tail == NPROC)
-    panic("filled queue");
-  for(int i = 0; i < queue[id].tail; i++) {
-    if(queue[id].proc[i]->pid == p->pid)
+  // Order the store that queued p before the loads of idle,
+  // pairing with the xchg in scheduler().
+  __sync_synchronize();
+  c = &cpus[homecpu(p)];
+  if(c->idle && cpuok(p, c) && xchg(&c->idle, 0)){
+    lapicipi(c->apicid, T_IRQ0 + IRQ_RESCHED);
+    return;
+  }
+  for(c = cpus; c < cpus+ncpu; c++){
+    if(c->idle && cpuok(p, c) && xchg(&c->idle, 0)){
+      lapicipi(c->apicid, T_IRQ0 + IRQ_RESCHED);
       return;
+    }
   }
-  queue[id].proc[queue[id].tail++] = p;
-  p->queue = id;
-  p->qtime = 0;
-  p->lastref = ticks;
-  return;
-}     
+}
 
-// Removes process from queue if found
-// Does nothing otherwise
-void
-removeproc(struct proc *p, int id)
-{
-  // cprintf("Removed proc %d from %d\n",p->pid, id);
-  for(int i = 0; i < queue[id].tail; i++){
-    if(queue[id].proc[i]->pid == p->pid) {
-      queue[id].proc[i] = 0;
-      for(int j = i; j < queue[id].tail; j++){
-        if(j < queue[id].tail - 1)
-          queue[id].proc[j] = queue[id].proc[j + 1];
-        else
-          queue[id].proc[j] = 0;
-      }
-      queue[id].tail--;
-      return;
+// Might cpu c find a process to run? Only a hint, since
+// it is called without the run queue locks.
+static int
+havework(struct cpu *c)
+{
+  if(nrtready > 0)
+    return 1;
+  return policy->work(c);
+}
+
+// Record that p, just taken off the run queues, is to run
+// on cpu c. The lock of the queue it was on must be held.
+static void
+moveto(struct proc *p, struct cpu *c)
+{
+  if(p->ntimes > 0 && p->lastcpu != c - cpus)
+    p->nmigrate++;
+  p->lastcpu = c - cpus;
+}
+
+// Take the next process to run on c off the run queues,
+// or return 0. Real-time processes run before every other class.
+static struct proc*
+picknext(struct cpu *c)
+{
+  struct spinlock *lk;
+  struct proc *p;
+
+  if(nrtready > 0){
+    acquire(&rqlock);
+    if((p = edfpick(c)) != 0){
+      nrtready--;
+      p->onrq = 0;
+      moveto(p, c);
     }
+    release(&rqlock);
+    if(p != 0)
+      return p;
+  }
+  lk = lockcpu(c);
+  if((p = policy->picknext(c)) != 0){
+    p->onrq = 0;
+    moveto(p, c);
+  }
+  release(lk);
+  return p;
+}
+
+// Mark p, whose lock is held, as running on this cpu.
+// dispatch is 0 if p was already running here and carries on,
+// which doesn't count as another time it was run.
+static void
+run(struct proc *p, int dispatch)
+{
+  uint64 now = nsecs();
+
+  p->waitns += now - p->readyat;
+  p->runstart = now;
+  p->state = RUNNING;
+  if(dispatch)
+    p->ntimes++;
+  p->lastref = ticks;
+}
+
+// Release the lock of the process that switched directly to
+// the current one, which sched() leaves held across the swtch.
+static void
+finishswitch(void)
+{
+  struct cpu *c = mycpu();
+  struct proc *p;
+
+  if((p = c->prev) != 0){
+    c->prev = 0;
+    release(&p->lock);
   }
-  return;
 }
 
 //PAGEBREAK: 42
@@ -505,9 +1244,6 @@ void
 scheduler(void)
 {
   struct proc *p;
-#ifndef RR
-  struct proc *chosen;
-#endif
   struct cpu *c = mycpu();
   c->proc = 0;
   
@@ -515,191 +1251,109 @@ scheduler(void)
     // Enable interrupts on this processor.
     sti();
 
-    // Loop over process table looking for process to run.
-    acquire(&ptable.lock);
-#ifdef RR
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->state != RUNNABLE)
-        continue;
-
-      // Switch to chosen process.  It is the process's job
-      // to release ptable.lock and then reacquire it
-      // before jumping back to us.
-      c->proc = p;
-      switchuvm(p);
-      p->state = RUNNING;
-      // chosen->ntimes++;
-      // chosen->lastref = ticks;
-
-      swtch(&(c->scheduler), p->context);
-      switchkvm();
-
-      // Process is done running for now.
-      // It should have changed its p->state before coming back.
-      c->proc = 0;
-    }
-#endif
-#ifdef FCFS
-    chosen = (struct proc*) 0;
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->state == RUNNABLE){
-        if(chosen == (struct proc*)0)
-          chosen = p;
-        else if(p->ctime < chosen->ctime)
-          chosen = p;
+    // sched() may have left a process it chose for us.
+    if((p = c->next) != 0)
+      c->next = 0;
+    else {
+      // Don't take a run queue lock if there is nothing to run,
+      // or only processes that may not run here: halt until an
+      // interrupt instead. kick() sends a reschedule IPI to an
+      // idle cpu when it queues work, so announce being idle
+      // before the last look for work, with interrupts off so
+      // that the IPI can't arrive before the hlt.
+      if(!havework(c) || (p = picknext(c)) == 0){
+        cli();
+        xchg(&c->idle, 1);
+        p = havework(c) ? picknext(c) : 0;
+        if(p == 0)
+          stihlt();
+        c->idle = 0;
+        if(p == 0)
+          continue;
       }
     }
 
-    if(chosen == 0){
-      release(&ptable.lock);
-      continue;
-    }
+    // Switch to chosen process.  It is the process's job
+    // to release p->lock and then reacquire it
+    // before jumping back to us. Taking it here waits for
+    // the cpu that last ran p to finish switching away.
+    acquire(&p->lock);
+    c->proc = p;
+    switchuvm(p);
+    run(p, 1);
 
-    c->proc = chosen;
-    switchuvm(chosen);
-    chosen->state = RUNNING;
-    chosen->ntimes++;
-    chosen->lastref = ticks;
-    swtch(&(c->scheduler), chosen->context);
+    swtch(&(c->scheduler), p->context);
     switchkvm();
 
     // Process is done running for now.
-    // It should have changed its p->state before coming back.
-    c->proc = 0;
-#endif
-#ifdef PBS
-    chosen = (struct proc *) 0;
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->state == RUNNABLE){        
-        if(chosen == (struct proc *)0)
-          chosen = p;
-        else if(p->priority < chosen->priority)
-          chosen = p;
-        else if(p->priority == chosen->priority){
-          if(p->ntimes < chosen->ntimes)
-            chosen = p;
-          else if(p->ntimes == chosen->ntimes && p->ctime < chosen->ctime)
-            chosen = p;
-        }
-      }
-    }
-    if(chosen == 0){
-      release(&ptable.lock);
-      continue;
-    }
-    c->proc = chosen;
-    switchuvm(chosen);
-    chosen->state = RUNNING;
-    chosen->ntimes++;
-    chosen->lastref = ticks;
-    swtch(&(c->scheduler), chosen->context);
-    switchkvm();
- 
-     // Process is done running for now.
-    // It should have changed its p->state before coming back.
-    c->proc = 0;
-#endif
-#ifdef MLFQ
-    // Add new processes
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->state == RUNNABLE && p->queue < 0){
-        addproc(p, 0);
-      }
-    }
-    // Promote processes
-    for(int i = 0; i < NQUEUE; i++){
-      if(i > 0){
-        for(int j = 0; j < queue[i].tail; j++){
-          struct proc* p = queue[i].proc[j];
-          if(p->state == RUNNABLE && 
-              ticks - p->lastref >= 30){ // Over 30 ticks from last scheduling
-            // cprintf("[%d] Promoted [%d] froom queue _%d_ to _%d_\n",
-            //         ticks, p->pid, i, i - 1);
-            removeproc(p, i);
-            addproc(p, i - 1);
-            p->timeslice = 0;
-            j--;
-          }
-        }
-      }
-    }
-    chosen = (struct proc *) 0;
-    for(int i = 0; i < NQUEUE; i++){
-      if(queue[i].tail > 0){
-        chosen = queue[i].proc[0];
-
-        if(chosen == 0) 
-          continue;
-        if(chosen->state == RUNNABLE)
-          break;
-        else
-          removeproc(chosen, i);
-      }
-    }
-    
-    if(chosen == 0 || chosen->state != RUNNABLE){
-      release(&ptable.lock);
-      continue;
-    }
-    // cprintf("[%d] Running [%d] in queue _%d_\n", 
-    //         ticks, chosen->pid, chosen->queue);
-    c->proc = chosen;
-    switchuvm(chosen);
-    chosen->state = RUNNING;
-    chosen->lastref = ticks;
-    chosen->ntimes++;
-    swtch(&(c->scheduler), chosen->context);
-    switchkvm();
- 
-     // Process is done running for now.
-    // It should have changed its p->state before coming back.
+    // It should have changed its p->state before coming back,
+    // and requeued itself through ready() if still RUNNABLE.
+    // It may not be the process we switched to, since sched()
+    // switches from process to process directly.
+    p = c->proc;
     c->proc = 0;
-
-    // If force-fully given up control
-    if(chosen != 0 && chosen->state == RUNNABLE){
-      int q = chosen->queue;
-      if(chosen->demote){ // demote
-        chosen->demote = 0;
-        removeproc(chosen, q);
-        if(q < NQUEUE - 1){
-          // cprintf("[%d] Demoted [%d] from _%d_ to _%d_\n", 
-                // ticks,chosen->pid, q, q + 1);
-          addproc(chosen, q + 1);
-        } else {
-          addproc(chosen, q);
-        }
-        chosen->timeslice = 0;
-      }
-    }
-    
-#endif
-    release(&ptable.lock);
+    release(&p->lock);
   }
 }
 
-// Enter scheduler.  Must hold only ptable.lock
+// Enter scheduler.  Must hold only p->lock
 // and have changed proc->state. Saves and restores
 // intena because intena is a property of this
 // kernel thread, not this CPU. It should
 // be proc->intena and proc->ncli, but that would
 // break in the few places where a lock is held but
 // there's no process.
+//
+// sched() picks the next process itself and, when it can
+// take that process's lock at once, switches straight to it
+// without going through the scheduler thread and the kernel
+// page table. p->lock stays held across that switch, and the
+// next process releases it in finishswitch().
 void
 sched(void)
 {
   int intena;
   struct proc *p = myproc();
+  struct proc *np;
+  struct cpu *c;
 
-  if(!holding(&ptable.lock))
-    panic("sched ptable.lock");
+  if(!holding(&p->lock))
+    panic("sched p->lock");
   if(mycpu()->ncli != 1)
     panic("sched locks");
   if(p->state == RUNNING)
     panic("sched running");
   if(readeflags()&FL_IF)
     panic("sched interruptible");
-  intena = mycpu()->intena;
-  swtch(&p->context, mycpu()->scheduler);
+  p->rtimens += nsecs() - p->runstart;
+  c = mycpu();
+  intena = c->intena;
+  if((np = c->next) != 0)
+    c->next = 0;
+  else
+    np = picknext(c);
+  if(np == p){
+    // p was queued by yield() and is still the one to run.
+    run(p, 0);
+    return;
+  }
+  if(np != 0 && !tryacquire(&np->lock)){
+    // np is still switching away on another cpu.
+    // Leave it for the scheduler, which can wait for it
+    // without holding p->lock.
+    c->next = np;
+    np = 0;
+  }
+  if(np == 0)
+    swtch(&p->context, c->scheduler);
+  else {
+    c->prev = p;
+    c->proc = np;
+    switchuvm(np);
+    run(np, 1);
+    swtch(&p->context, np->context);
+  }
+  finishswitch();
   mycpu()->intena = intena;
 }
 
@@ -707,10 +1361,49 @@ sched(void)
 void
 yield(void)
 {
-  acquire(&ptable.lock);  //DOC: yieldlock
-  myproc()->state = RUNNABLE;
+  struct proc *p = myproc();
+
+  acquire(&p->lock);  //DOC: yieldlock
+  ready(p);
   sched();
+  release(&p->lock);
+}
+
+// Give up the CPU to the process with the given pid, which
+// must be RUNNABLE and waiting to run, not real-time, and
+// allowed to run on this cpu.
+// The caller is queued as in yield().
+// Return -1 if there is no such process, else 0.
+int
+yieldto(int pid)
+{
+  struct proc *p = myproc();
+  struct proc *np;
+  struct spinlock *lk;
+
+  acquire(&ptable.lock);
+  if((np = findproc(pid)) == 0 || np == p){
+    release(&ptable.lock);
+    return -1;
+  }
+  acquire(&p->lock);
+  lk = lockrq(np, 0);
   release(&ptable.lock);
+  if(!np->onrq || np->rtperiod || !cpuok(np, mycpu())){
+    release(lk);
+    release(&p->lock);
+    return -1;
+  }
+  policy->dequeue(np);
+  np->onrq = 0;
+  moveto(np, mycpu());
+  release(lk);
+
+  ready(p);
+  mycpu()->next = np;
+  sched();
+  release(&p->lock);
+  return 0;
 }
 
 // A fork child's very first scheduling by scheduler()
@@ -719,8 +1412,10 @@ void
 forkret(void)
 {
   static int first = 1;
-  // Still holding ptable.lock from scheduler.
-  release(&ptable.lock);
+  // Still holding p->lock from scheduler, or from
+  // the process that switched directly to us.
+  finishswitch();
+  release(&myproc()->lock);
 
   if (first) {
     // Some initialization functions must be run in the context
@@ -740,6 +1435,7 @@ void
 sleep(void *chan, struct spinlock *lk)
 {
   struct proc *p = myproc();
+  struct sleepq *q;
   
   if(p == 0)
     panic("sleep");
@@ -747,19 +1443,23 @@ sleep(void *chan, struct spinlock *lk)
   if(lk == 0)
     panic("sleep without lk");
 
-  // Must acquire ptable.lock in order to
-  // change p->state and then call sched.
-  // Once we hold ptable.lock, we can be
+  // Must acquire chan's wait queue lock in order to
+  // join the queue, and p->lock in order to change
+  // p->state and then call sched.
+  // Once we hold the queue lock, we can be
   // guaranteed that we won't miss any wakeup
-  // (wakeup runs with ptable.lock locked),
+  // (wakeup runs with the queue lock locked),
   // so it's okay to release lk.
-  if(lk != &ptable.lock){  //DOC: sleeplock0
-    acquire(&ptable.lock);  //DOC: sleeplock1
-    release(lk);
-  }
+  q = &sleepq[chanhash(chan)];
+  acquire(&q->lock);  //DOC: sleeplock1
+  release(lk);
+  acquire(&p->lock);
+
   // Go to sleep.
   p->chan = chan;
   p->state = SLEEPING;
+  sleepenq(p);
+  release(&q->lock);
 
   sched();
 
@@ -767,47 +1467,53 @@ sleep(void *chan, struct spinlock *lk)
   p->chan = 0;
 
   // Reacquire original lock.
-  if(lk != &ptable.lock){  //DOC: sleeplock2
-    release(&ptable.lock);
-    acquire(lk);
-  }
+  release(&p->lock);
+  acquire(lk);
 }
 
 //PAGEBREAK!
 // Wake up all processes sleeping on chan.
-// The ptable lock must be held.
-static void
-wakeup1(void *chan)
+// A process on a wait queue can't leave it or change its
+// chan without the queue lock, but may still be on its way
+// into sched(): taking p->lock waits for it to get there.
+void
+wakeup(void *chan)
 {
-  struct proc *p;
-
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    if(p->state == SLEEPING && p->chan == chan){
-      p->state = RUNNABLE;
-#ifdef MLFQ
-      int q = p->queue;
-      if(p->demote){ // demote
-        p->demote = 0;
-        removeproc(p, q);
-        if(q < NQUEUE - 1){
-          q++;
-        }
-      } else {
-        removeproc(p, q);
-      }
-      p->timeslice = 0;
-      addproc(p, q);
-#endif
+  struct proc *p, *next;
+  uint h = chanhash(chan);
+
+  acquire(&sleepq[h].lock);
+  for(p = sleepq[h].head; p != 0; p = next){
+    next = p->slnext;
+    if(p->chan == chan){
+      acquire(&p->lock);
+      unsleep(p);
+      release(&p->lock);
     }
+  }
+  release(&sleepq[h].lock);
 }
 
-// Wake up all processes sleeping on chan.
+// Wake up the process that has slept longest on chan, for
+// channels where only one waiter can make progress. A waiter
+// woken this way that gives up without using what it was
+// woken for must pass the wakeup on.
 void
-wakeup(void *chan)
+wakeone(void *chan)
 {
-  acquire(&ptable.lock);
-  wakeup1(chan);
-  release(&ptable.lock);
+  struct proc *p;
+  uint h = chanhash(chan);
+
+  acquire(&sleepq[h].lock);
+  for(p = sleepq[h].head; p != 0; p = p->slnext){
+    if(p->chan == chan){
+      acquire(&p->lock);
+      unsleep(p);
+      release(&p->lock);
+      break;
+    }
+  }
+  release(&sleepq[h].lock);
 }
 
 // Kill the process with the given pid.
@@ -817,35 +1523,32 @@ int
 kill(int pid)
 {
   struct proc *p;
+  void *chan;
+  uint h;
 
   acquire(&ptable.lock);
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->pid == pid){
-      p->killed = 1;
-      // Wake process from sleep if necessary.
-      if(p->state == SLEEPING){
-        p->state = RUNNABLE;
-#ifdef MLFQ
-        int q = p->queue;
-        if(p->demote){ // demote
-          p->demote = 0;
-          removeproc(p, q);
-          if(q < NQUEUE - 1){
-            q++;
-          }
-        } else {
-          removeproc(p, q);
-        }
-        p->timeslice = 0;
-        addproc(p, q);
-#endif
-      }
-      release(&ptable.lock);
-      return 0;
-    }
+  if((p = findproc(pid)) == 0){
+    release(&ptable.lock);
+    return -1;
+  }
+  acquire(&p->lock);
+  p->killed = 1;
+  // Wake process from sleep if necessary. Its wait queue's
+  // lock comes before p->lock, so drop p->lock to take it
+  // and check that p is still asleep on the same chan.
+  while(p->state == SLEEPING){
+    chan = p->chan;
+    release(&p->lock);
+    h = chanhash(chan);
+    acquire(&sleepq[h].lock);
+    acquire(&p->lock);
+    if(p->state == SLEEPING && p->chan == chan)
+      unsleep(p);
+    release(&sleepq[h].lock);
   }
+  release(&p->lock);
   release(&ptable.lock);
-  return -1;
+  return 0;
 }
 
 //PAGEBREAK: 36
@@ -868,9 +1571,7 @@ procdump(void)
   char *state;
   uint pc[10];
 
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->state == UNUSED)
-      continue;
+  for(p = ptable.head; p != 0; p = p->allnext){
     if(p->state >= 0 && p->state < NELEM(states) && states[p->state])
       state = states[p->state];
     else
@@ -885,25 +1586,68 @@ procdump(void)
   }
 }
 
-void
-processinfo(struct procstat * res)
+// Fill in the tick counts of each cpu.
+// Return the number of cpus.
+int
+cpuinfo(struct cpustat *res)
+{
+  struct cpu *c;
+  int i;
+
+  for(c = cpus, i = 0; c < cpus+ncpu; c++, i++){
+    res[i].cpu = i;
+    res[i].busy = c->busyticks;
+    res[i].idle = c->idleticks;
+    res[i].nresched = c->nresched;
+    res[i].load = (c->loadavg * 100) >> FSHIFT;
+    res[i].npulled = c->npulled;
+  }
+  return ncpu;
+}
+
+// Fill in res with the state of up to n processes with pids
+// greater than pid, in pid order, so that callers can page
+// through the process table.
+// Return the number filled in.
+int
+processinfo(struct procstat *res, int n, int pid)
 {
-  acquire(&ptable.lock);
   struct proc* p;
+  uint64 now;
   int i;
-  for(p = ptable.proc, i = 0; p < &ptable.proc[NPROC]; p++, i++){
-    if(p !=  0){
-      res[i].nrun = p->ntimes;
-      res[i].curq = p->queue;
-      res[i].pid = p->pid;
-      res[i].priority = p->priority;
-      res[i].rtime = p->rtime;
-      res[i].wtime = ticks - p->lastref;
-      res[i].state = p->state;
-      for(int j = 0; j < NQUEUE; j++)
-        res[i].ticks[j] = p->ticks[j];
-    }
+
+  acquire(&ptable.lock);
+  now = nsecs();
+  if((p = findproc(pid)) != 0)
+    p = p->allnext;
+  else
+    for(p = ptable.head; p != 0 && p->pid <= pid; p = p->allnext)
+      ;
+  for(i = 0; p != 0 && i < n; p = p->allnext, i++){
+    res[i].nrun = p->ntimes;
+    res[i].curq = p->queue;
+    res[i].pid = p->pid;
+    res[i].priority = p->priority;
+    res[i].rtime = p->rtime;
+    res[i].wtime = ticks - p->lastref;
+    res[i].state = p->state;
+    res[i].tickets = p->tickets;
+    res[i].rtmisses = p->rtmisses;
+    res[i].lastcpu = p->lastcpu;
+    res[i].nmigrate = p->nmigrate;
+    res[i].rtimens = p->rtimens;
+    res[i].waitns = p->waitns;
+    // Add the current stretch; racy, but only a report.
+    if(p->state == RUNNING)
+      res[i].rtimens += now - p->runstart;
+    else if(p->state == RUNNABLE)
+      res[i].waitns += now - p->readyat;
+    res[i].share = 0;
+    if(ticks - p->ctime > 0)
+      res[i].share = p->rtime * 100 / (ticks - p->ctime);
+    for(int j = 0; j < NQUEUE; j++)
+      res[i].ticks[j] = p->ticks[j];
   }
   release(&ptable.lock);
-  return;
+  return i;
 }
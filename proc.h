@@ -1,3 +1,35 @@
+// Red-black tree node, embedded in the object it orders.
+// Nodes with equal keys keep their insertion order.
+struct rbnode {
+  struct rbnode *parent;
+  struct rbnode *left;
+  struct rbnode *right;
+  int red;
+  uint key;                    // Compared with wraparound, as ticks are
+};
+
+struct rbtree {
+  struct rbnode *root;
+  struct rbnode *min;          // Leftmost node, or 0 if empty
+  volatile int n;              // Number of nodes
+};
+
+// Convert a pointer to an embedded rbnode back to its container.
+#define rbentry(node, type, member) \
+  ((type*)((char*)(node) - (uint)&((type*)0)->member))
+
+// Queue of RUNNABLE processes, threaded through proc->rqnext.
+// A cpu's own queue is protected by its lock; the queues a policy
+// shares between cpus are protected by the global run queue lock
+// instead, and leave theirs unused. len may be read without the
+// lock to decide whether to take it.
+struct runq {
+  struct spinlock lock;        // Protects a cpu's own queue
+  struct proc *head;           // Next process to run
+  struct proc *tail;           // Most recently queued process
+  volatile int len;            // Number of queued processes
+};
+
 // Per-CPU state
 struct cpu {
   uchar apicid;                // Local APIC ID
@@ -8,8 +40,21 @@ struct cpu {
   int ncli;                    // Depth of pushcli nesting.
   int intena;                  // Were interrupts enabled before pushcli?
   struct proc *proc;           // The process running on this cpu or null
+  struct proc *next;           // Process sched() chose to run next, or null
+  struct proc *prev;           // Process switched away from, still locked
+  struct runq rq;              // Processes waiting to run on this cpu
+  volatile uint idle;          // Halted, or about to halt, in scheduler()
+  uint busyticks;              // Timer ticks spent running a process
+  uint idleticks;              // Timer ticks spent in the scheduler
+  uint nresched;               // Reschedule IPIs received
+  uint loadavg;                // Average of runnable processes, << FSHIFT
+  uint npulled;                // Processes the load balancer moved here
 };
 
+// Cpu load averages are fixed point with FSHIFT fraction bits.
+#define FSHIFT  11
+#define FIXED1  (1 << FSHIFT)
+
 extern struct cpu cpus[NCPU];
 extern int ncpu;
 
@@ -39,12 +84,20 @@ struct proc {
   uint sz;                     // Size of process memory (bytes)
   pde_t* pgdir;                // Page table
   char *kstack;                // Bottom of kernel stack for this process
+  struct spinlock lock;        // Protects state, chan and switching to it
   enum procstate state;        // Process state
   int pid;                     // Process ID
   struct proc *parent;         // Parent process
+  struct proc *children;       // First child process
+  struct proc *sibling;        // Next child of the same parent
+  struct proc *pidnext;        // Next process in the same pid hash chain
+  struct proc *allnext;        // Next process in ptable, or on its free list
+  struct proc *allprev;        // Previous process in ptable
   struct trapframe *tf;        // Trap frame for current syscall
   struct context *context;     // swtch() here to run process
   void *chan;                  // If non-zero, sleeping on chan
+  struct proc *slnext;         // Next process on the same wait queue
+  struct proc *slprev;         // Previous process on the same wait queue
   int killed;                  // If non-zero, have been killed
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
@@ -52,7 +105,17 @@ struct proc {
   int rtime;                   // Time spent Running
   int ctime;                   // Creation time
   int etime;                   // End time
-  int priority;                // Process Priority
+  uint64 ctimens;              // Creation time, in ns since boot
+  uint64 etimens;              // End time, in ns since boot
+  uint64 rtimens;              // Time spent RUNNING, in ns
+  uint64 waitns;               // Time spent RUNNABLE, in ns
+  uint64 runstart;             // When it last started RUNNING, in ns
+  uint64 readyat;              // When it last became RUNNABLE, in ns
+  int priority;                // Process Priority, raised by inheritance
+  int basepriority;            // Priority it was given by setpriority()
+  struct sleeplock *held;      // Sleep locks it holds, see sleeplock.c
+  struct sleeplock *blockedon; // Sleep lock it is waiting for
+  struct proc *pinext;         // Next waiter for the same sleep lock
   int ntimes;                  // Times process has be executed
   int queue;                   // Current Queue
   int ticks[NQUEUE];           // Ticks accumulated in each Queue
@@ -60,10 +123,50 @@ struct proc {
   int qtime;                   // Time entered in current queue
   int lastref;                 // Time when it was last scheduled
   int demote;                  // Demote flag
+  int onrq;                    // Waiting on a run queue or as real-time
+  struct proc *rqnext;         // Next process on the same run queue
+  struct proc *rqprev;         // Previous process on the same MLFQ queue
+  int lastcpu;                 // CPU it last ran on
+  int rqcpu;                   // CPU whose run queue it is on (RR)
+  uint affinity;               // Mask of the CPUs it may run on
+  int nmigrate;                // Times it ran on a different CPU than last
+  uint vruntime;               // Run time scaled by weight (CFS)
+  int tickets;                 // Share of the CPU (STRIDE)
+  uint pass;                   // Run time scaled by 1/tickets (STRIDE)
+  struct rbnode rb;            // Node in the CFS or STRIDE run tree
+  int rtperiod;                // Real-time period in ticks, 0 if not RT
+  int rtruntime;               // Ticks of CPU in each period
+  int rtdeadline;              // Deadline relative to each release
+  int rtutil;                  // Utilization in per-mille of a CPU
+  uint rtrelease;              // Release time of the current job
+  int rtbudget;                // Ticks left for the current job
+  int rtdone;                  // Current job has finished
+  int rtlate;                  // Current job has missed its deadline
+  int rtmisses;                // Jobs that missed their deadline
+  struct proc *rtnext;         // Next process on the real-time list
 };
 
 #define qpriority(x) (1<<(x))
 
+// May process p run on cpu c?
+#define cpuok(p, c) (((p)->affinity >> ((c) - cpus)) & 1)
+
+// A scheduling policy, see sched.c. All but tick() and work()
+// are called with the lock of the run queue they work on held.
+struct schedops {
+  int id;                             // SCHED_* from sched.h
+  char *name;
+  int percpu;                         // Queues on each cpu's own run queue?
+  void (*enqueue)(struct proc*);      // Queue a process made RUNNABLE
+  void (*dequeue)(struct proc*);      // Take a RUNNABLE process off the queues
+  struct proc *(*picknext)(struct cpu*);  // Dequeue the next process to run, or 0
+  void (*tick)(struct proc*);         // Charge the running process a tick
+  int (*yield)(struct proc*);         // Should the running process yield?
+  int (*work)(struct cpu*);           // Might the cpu find work? A hint
+  void (*balance)(struct cpu*);       // Pull work to the cpu, or 0
+  void (*setpriority)(struct proc*, int);  // Reprioritize a queued process, or 0
+};
+
 // Process memory is laid out contiguously, low addresses first:
 //   text
 //   original data and bss
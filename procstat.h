@@ -9,4 +9,11 @@ struct procstat {
   int nrun;
   int curq;
   int ticks[NQUEUE];
+  int tickets;
+  int share;     // Percent of its lifetime spent running
+  int rtmisses;  // Real-time jobs that missed their deadline
+  int lastcpu;   // CPU it last ran on
+  int nmigrate;  // Times it ran on a different CPU than last
+  uint64 rtimens;  // Time spent running, in ns
+  uint64 waitns;   // Time spent waiting to run, in ns
 };
\ No newline at end of file
@@ -4,49 +4,61 @@
 #include "stat.h"
 #include "user.h"
 #include "procstat.h"
+#include "sched.h"
 
-struct procstat buf[NPROC];
+#define NPS 16  // processes fetched per procinfo() call
+
+struct procstat buf[NPS];
 
 
 // enum procstate { UNUSED, EMBRYO, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
 int main(int argc, char** argv) {
-    procinfo(buf);
+    int sched = schedctl(-1);
+    int n, last = 0;
     printf(1, "pid\tprty\tstate     \trtime\twtime\tnrun\t");
-#ifdef MLFQ
-    printf(1, "currq\tq0\tq1\tq2\tq3\tq4\n");
-#endif
-    for(int i = 0; i < NPROC; i++){
-        if(buf[i].pid > 0 && buf[i].state > 0){
-            printf(1,"%d\t%d\t", buf[i].pid, buf[i].priority);
-            switch (buf[i].state){
-            case 1:
-                printf(1,"embryo  \t");
-                break;
-            case 2:
-                printf(1,"sleeping\t");
-                break;
-            case 3:
-                printf(1,"waiting \t");
-                break;
-            case 4:
-                printf(1,"running \t");
-                break;
-            case 5:
-                printf(1,"zombie  \t");
-                break;
-            default:
-                break;
-            }
-            printf(1, "%d\t%d\t%d\t", buf[i].rtime, buf[i].wtime, buf[i].nrun);
-#ifdef MLFQ
-            printf(1, "%d\t", buf[i].curq);
-            for(int j = 0; j < NQUEUE; j++){
-                printf(1, "%d\t",buf[i].ticks[j]);
+    if(sched == SCHED_MLFQ)
+        printf(1, "currq\tq0\tq1\tq2\tq3\tq4");
+    if(sched == SCHED_STRIDE)
+        printf(1, "tickets\tshare");
+    printf(1, "\n");
+    // Page through the process table NPS processes at a time.
+    while((n = procinfo(buf, NPS, last)) > 0){
+        for(int i = 0; i < n; i++){
+            if(buf[i].pid > 0 && buf[i].state > 0){
+                printf(1,"%d\t%d\t", buf[i].pid, buf[i].priority);
+                switch (buf[i].state){
+                case 1:
+                    printf(1,"embryo  \t");
+                    break;
+                case 2:
+                    printf(1,"sleeping\t");
+                    break;
+                case 3:
+                    printf(1,"waiting \t");
+                    break;
+                case 4:
+                    printf(1,"running \t");
+                    break;
+                case 5:
+                    printf(1,"zombie  \t");
+                    break;
+                default:
+                    break;
+                }
+                printf(1, "%d\t%d\t%d\t", buf[i].rtime, buf[i].wtime, buf[i].nrun);
+                if(sched == SCHED_MLFQ){
+                    printf(1, "%d\t", buf[i].curq);
+                    for(int j = 0; j < NQUEUE; j++){
+                        printf(1, "%d\t",buf[i].ticks[j]);
+                    }
+                }
+                if(sched == SCHED_STRIDE)
+                    printf(1, "%d\t%d%%\t", buf[i].tickets, buf[i].share);
+                printf(1, "\n");     
             }
-#endif       
-            printf(1, "\n");     
         }
+        last = buf[n-1].pid;
     }
     exit();
 }
\ No newline at end of file
@@ -0,0 +1,265 @@
+// Red-black trees, used by the scheduler to keep RUNNABLE
+// processes ordered by a key such as their virtual run time.
+// Insertion and removal are O(log n); the smallest node is
+// cached so finding it is O(1). Callers provide the locking.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "spinlock.h"
+#include "proc.h"
+
+static int
+isred(struct rbnode *n)
+{
+  return n != 0 && n->red;
+}
+
+// Keys are compared as a signed difference so that a key
+// that has wrapped around still orders after a smaller one.
+static int
+keyless(uint a, uint b)
+{
+  return (int)(a - b) < 0;
+}
+
+static void
+rotleft(struct rbtree *t, struct rbnode *x)
+{
+  struct rbnode *y = x->right;
+
+  x->right = y->left;
+  if(y->left)
+    y->left->parent = x;
+  y->parent = x->parent;
+  if(x->parent == 0)
+    t->root = y;
+  else if(x == x->parent->left)
+    x->parent->left = y;
+  else
+    x->parent->right = y;
+  y->left = x;
+  x->parent = y;
+}
+
+static void
+rotright(struct rbtree *t, struct rbnode *x)
+{
+  struct rbnode *y = x->left;
+
+  x->left = y->right;
+  if(y->right)
+    y->right->parent = x;
+  y->parent = x->parent;
+  if(x->parent == 0)
+    t->root = y;
+  else if(x == x->parent->right)
+    x->parent->right = y;
+  else
+    x->parent->left = y;
+  y->right = x;
+  x->parent = y;
+}
+
+// Return the node after n in key order, or 0.
+struct rbnode*
+rbnext(struct rbnode *n)
+{
+  struct rbnode *p;
+
+  if(n->right){
+    n = n->right;
+    while(n->left)
+      n = n->left;
+    return n;
+  }
+  while((p = n->parent) != 0 && n == p->right)
+    n = p;
+  return p;
+}
+
+// Insert n, whose key must already be set, into t.
+void
+rbinsert(struct rbtree *t, struct rbnode *n)
+{
+  struct rbnode **link, *parent, *g, *u;
+  int leftmost;
+
+  link = &t->root;
+  parent = 0;
+  leftmost = 1;
+  while(*link){
+    parent = *link;
+    if(keyless(n->key, parent->key))
+      link = &parent->left;
+    else {
+      link = &parent->right;
+      leftmost = 0;
+    }
+  }
+  n->parent = parent;
+  n->left = 0;
+  n->right = 0;
+  n->red = 1;
+  *link = n;
+  if(leftmost)
+    t->min = n;
+  t->n++;
+
+  // Restore the red-black properties.
+  while((parent = n->parent) != 0 && parent->red){
+    g = parent->parent;
+    if(parent == g->left){
+      u = g->right;
+      if(isred(u)){
+        parent->red = 0;
+        u->red = 0;
+        g->red = 1;
+        n = g;
+        continue;
+      }
+      if(n == parent->right){
+        rotleft(t, parent);
+        n = parent;
+        parent = n->parent;
+      }
+      parent->red = 0;
+      g->red = 1;
+      rotright(t, g);
+    } else {
+      u = g->left;
+      if(isred(u)){
+        parent->red = 0;
+        u->red = 0;
+        g->red = 1;
+        n = g;
+        continue;
+      }
+      if(n == parent->left){
+        rotright(t, parent);
+        n = parent;
+        parent = n->parent;
+      }
+      parent->red = 0;
+      g->red = 1;
+      rotleft(t, g);
+    }
+  }
+  t->root->red = 0;
+}
+
+// Replace the subtree rooted at u with the one rooted at v.
+static void
+transplant(struct rbtree *t, struct rbnode *u, struct rbnode *v)
+{
+  if(u->parent == 0)
+    t->root = v;
+  else if(u == u->parent->left)
+    u->parent->left = v;
+  else
+    u->parent->right = v;
+  if(v)
+    v->parent = u->parent;
+}
+
+// Remove n from t.
+void
+rberase(struct rbtree *t, struct rbnode *n)
+{
+  struct rbnode *x, *xp, *y, *w;
+  int yred;
+
+  if(t->min == n)
+    t->min = rbnext(n);
+
+  yred = n->red;
+  if(n->left == 0){
+    x = n->right;
+    xp = n->parent;
+    transplant(t, n, n->right);
+  } else if(n->right == 0){
+    x = n->left;
+    xp = n->parent;
+    transplant(t, n, n->left);
+  } else {
+    y = n->right;
+    while(y->left)
+      y = y->left;
+    yred = y->red;
+    x = y->right;
+    if(y->parent == n)
+      xp = y;
+    else {
+      xp = y->parent;
+      transplant(t, y, y->right);
+      y->right = n->right;
+      y->right->parent = y;
+    }
+    transplant(t, n, y);
+    y->left = n->left;
+    y->left->parent = y;
+    y->red = n->red;
+  }
+  n->parent = n->left = n->right = 0;
+  t->n--;
+  if(yred)
+    return;
+
+  // A black node was removed: x carries an extra black.
+  while(x != t->root && !isred(x)){
+    if(x == xp->left){
+      w = xp->right;
+      if(w->red){
+        w->red = 0;
+        xp->red = 1;
+        rotleft(t, xp);
+        w = xp->right;
+      }
+      if(!isred(w->left) && !isred(w->right)){
+        w->red = 1;
+        x = xp;
+        xp = x->parent;
+      } else {
+        if(!isred(w->right)){
+          w->left->red = 0;
+          w->red = 1;
+          rotright(t, w);
+          w = xp->right;
+        }
+        w->red = xp->red;
+        xp->red = 0;
+        w->right->red = 0;
+        rotleft(t, xp);
+        x = t->root;
+      }
+    } else {
+      w = xp->left;
+      if(w->red){
+        w->red = 0;
+        xp->red = 1;
+        rotright(t, xp);
+        w = xp->left;
+      }
+      if(!isred(w->left) && !isred(w->right)){
+        w->red = 1;
+        x = xp;
+        xp = x->parent;
+      } else {
+        if(!isred(w->left)){
+          w->right->red = 0;
+          w->red = 1;
+          rotleft(t, w);
+          w = xp->left;
+        }
+        w->red = xp->red;
+        xp->red = 0;
+        w->left->red = 0;
+        rotright(t, xp);
+        x = t->root;
+      }
+    }
+  }
+  if(x)
+    x->red = 0;
+}
@@ -0,0 +1,87 @@
+// Test the earliest-deadline-first real-time class.
+// Runs a periodic real-time job next to CPU-bound background
+// processes and reports how late each job started after its
+// release (jitter) and how many deadlines were missed.
+
+#include "param.h"
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "procstat.h"
+
+#define NBG      4    // CPU-bound background processes
+#define NJOBS   50    // real-time jobs to run
+#define PERIOD  10    // ticks
+#define RUNTIME  3    // ticks of CPU budget per period
+#define WORK     2    // ticks of work each job does
+
+struct procstat st;
+
+void
+spin(void)
+{
+  volatile int x = 0;
+
+  for(;;)
+    x++;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int bg[NBG];
+  int i, rel, now, start, jitter, maxjitter, totaljitter, misses;
+
+  for(i = 0; i < NBG; i++){
+    if((bg[i] = fork()) < 0){
+      printf(2, "rttest: fork failed\n");
+      exit();
+    }
+    if(bg[i] == 0)
+      spin();
+  }
+
+  if(setrt(PERIOD, RUNTIME, PERIOD) < 0){
+    printf(2, "rttest: setrt failed\n");
+    exit();
+  }
+  // Admission control must refuse a second process that
+  // would take the total past one CPU.
+  if(fork() == 0){
+    if(setrt(PERIOD, PERIOD - RUNTIME + 1, PERIOD) == 0)
+      printf(1, "rttest: admission control failed\n");
+    else
+      printf(1, "admission control ok\n");
+    exit();
+  }
+  wait();
+
+  maxjitter = totaljitter = 0;
+  for(i = 0; i < NJOBS; i++){
+    if((rel = rtwait()) < 0){
+      printf(2, "rttest: rtwait failed\n");
+      break;
+    }
+    start = uptime();
+    jitter = start - rel;
+    totaljitter += jitter;
+    if(jitter > maxjitter)
+      maxjitter = jitter;
+    do
+      now = uptime();
+    while(now - start < WORK);
+  }
+  setrt(0, 0, 0);
+
+  misses = -1;
+  if(procinfo(&st, 1, getpid() - 1) == 1 && st.pid == getpid())
+    misses = st.rtmisses;
+
+  for(i = 0; i < NBG; i++){
+    kill(bg[i]);
+    wait();
+  }
+  printf(1, "%d jobs: jitter avg %d max %d ticks, %d deadline misses\n",
+         NJOBS, totaljitter / NJOBS, maxjitter, misses);
+  exit();
+}
@@ -0,0 +1,697 @@
+// Scheduling policies.
+//
+// Each policy keeps the RUNNABLE processes it is responsible for
+// in its own run queues and is reached through a struct schedops.
+// The policy in use starts as the one chosen with
+// make SCHEDULER=... and can be changed at run time with
+// schedctl(). Real-time processes are not handled here: they are
+// picked by proc.c ahead of the policy and never queued on it.
+//
+// A policy either shares its queues between all cpus and has
+// every operation called with proc.c's global run queue lock
+// held, or is percpu, queues each process on one cpu's own run
+// queue and has its operations called with that queue's lock
+// held: for enqueue() the queue of homecpu(p), for dequeue() and
+// setpriority() the one p is on (p->rqcpu), and for picknext()
+// and balance() the cpu's own. A percpu policy takes another
+// cpu's lock itself to steal or balance, with lockpeer(). The
+// exceptions are work(), which is only a hint, and tick(), which
+// each cpu calls for its own running process. The lock also
+// covers the scheduling fields of the processes on the queue.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "spinlock.h"
+#include "x86.h"
+#include "proc.h"
+#include "sched.h"
+
+// Append p to the tail of run queue rq.
+static void
+rqpush(struct runq *rq, struct proc *p)
+{
+  p->rqnext = 0;
+  p->rqprev = rq->tail;
+  if(rq->tail)
+    rq->tail->rqnext = p;
+  else
+    rq->head = p;
+  rq->tail = p;
+  rq->len++;
+}
+
+// Is p linked into run queue rq?
+static int
+rqhas(struct runq *rq, struct proc *p)
+{
+  return p->rqprev != 0 || rq->head == p;
+}
+
+// Unlink p from run queue rq.
+static void
+rqremove(struct runq *rq, struct proc *p)
+{
+  if(p->rqprev)
+    p->rqprev->rqnext = p->rqnext;
+  else
+    rq->head = p->rqnext;
+  if(p->rqnext)
+    p->rqnext->rqprev = p->rqprev;
+  else
+    rq->tail = p->rqprev;
+  p->rqnext = 0;
+  p->rqprev = 0;
+  rq->len--;
+}
+
+// Remove and return the process at the head of run queue rq,
+// or 0 if it is empty.
+static struct proc*
+rqpop(struct runq *rq)
+{
+  struct proc *p;
+
+  if((p = rq->head) != 0)
+    rqremove(rq, p);
+  return p;
+}
+
+// The policies below only pick a process for a cpu its affinity
+// allows, and prefer one that last ran on that cpu, whose cache
+// and TLB are still warm: of the first NWARM processes allowed on
+// the cpu, in the policy's order, they take the first that last
+// ran there, and otherwise the first. So the order may be bent by
+// up to NWARM-1 places to avoid a migration.
+#define NWARM 4
+
+// Did p last run on cpu c?
+#define warm(p, c) ((p)->lastcpu == (c) - cpus)
+
+// The cpu p should be queued on or woken on: the one it last ran
+// on if its affinity allows, else the first one that it allows.
+int
+homecpu(struct proc *p)
+{
+  int i;
+
+  if(cpuok(p, &cpus[p->lastcpu]))
+    return p->lastcpu;
+  for(i = 0; i < ncpu; i++)
+    if(cpuok(p, &cpus[i]))
+      return i;
+  return p->lastcpu;
+}
+
+// Pick a process from run queue rq for cpu c, as above,
+// without removing it. Return 0 if none may run on c.
+static struct proc*
+rqpick(struct runq *rq, struct cpu *c)
+{
+  struct proc *p, *first;
+  int n;
+
+  first = 0;
+  n = 0;
+  for(p = rq->head; p != 0; p = p->rqnext){
+    if(!cpuok(p, c))
+      continue;
+    if(warm(p, c))
+      return p;
+    if(first == 0)
+      first = p;
+    if(++n >= NWARM)
+      break;
+  }
+  return first;
+}
+
+// Pick a process from run tree t for cpu c, as above,
+// without removing it. Return 0 if none may run on c.
+static struct proc*
+rbpick(struct rbtree *t, struct cpu *c)
+{
+  struct rbnode *n;
+  struct proc *p, *first;
+  int i;
+
+  first = 0;
+  i = 0;
+  for(n = t->min; n != 0; n = rbnext(n)){
+    p = rbentry(n, struct proc, rb);
+    if(!cpuok(p, c))
+      continue;
+    if(warm(p, c))
+      return p;
+    if(first == 0)
+      first = p;
+    if(++i >= NWARM)
+      break;
+  }
+  return first;
+}
+
+//PAGEBREAK: 20
+// Round robin. Each cpu keeps its own run queue; a process goes
+// back on the queue of the cpu it last ran on, if its affinity
+// allows, and a cpu with nothing to do steals from the cpu with
+// the longest queue. Each queue has its own lock, so cpus only
+// meet on a lock to steal or balance.
+
+// Take the lock of b's run queue as well as c's, which the
+// caller holds. Run queue locks are taken in cpu order, so c's
+// may be let go for a moment.
+static void
+lockpeer(struct cpu *c, struct cpu *b)
+{
+  if(b < c){
+    release(&c->rq.lock);
+    acquire(&b->rq.lock);
+    acquire(&c->rq.lock);
+  } else
+    acquire(&b->rq.lock);
+}
+
+// Return the cpu other than c with the longest run queue,
+// or 0 if every other run queue is empty. Only reads the
+// queue lengths, so it may be called without the lock.
+static struct cpu*
+busiest(struct cpu *c)
+{
+  struct cpu *b, *best;
+  int len, max;
+
+  best = 0;
+  max = 0;
+  for(b = cpus; b < cpus+ncpu; b++){
+    if(b == c)
+      continue;
+    if((len = b->rq.len) > max){
+      max = len;
+      best = b;
+    }
+  }
+  return best;
+}
+
+static void
+rrenqueue(struct proc *p)
+{
+  p->rqcpu = homecpu(p);
+  rqpush(&cpus[p->rqcpu].rq, p);
+}
+
+static void
+rrdequeue(struct proc *p)
+{
+  rqremove(&cpus[p->rqcpu].rq, p);
+}
+
+// Take the longest-waiting process that may run on c from
+// the busiest peer of c if c has nothing of its own to run.
+static struct proc*
+rrpicknext(struct cpu *c)
+{
+  struct proc *p;
+  struct cpu *b;
+
+  if((p = rqpop(&c->rq)) != 0 || (b = busiest(c)) == 0)
+    return p;
+  lockpeer(c, b);
+  if((p = rqpop(&c->rq)) == 0 && (p = rqpick(&b->rq, c)) != 0){
+    rqremove(&b->rq, p);
+    // Now covered by c's lock, which the caller holds
+    // until it has marked p off the queues.
+    p->rqcpu = c - cpus;
+  }
+  release(&b->rq.lock);
+  return p;
+}
+
+// Move processes to c from the cpu with the longest run queue,
+// with hysteresis so that work doesn't bounce between cpus: only
+// if that cpu has at least two more runnable processes than c
+// now and one more on average, and only half the difference.
+static void
+rrbalance(struct cpu *c)
+{
+  struct cpu *b;
+  struct proc *p;
+  int n;
+
+  if((b = busiest(c)) == 0)
+    return;
+  lockpeer(c, b);
+  n = (b->rq.len + (b->proc != 0)) - (c->rq.len + (c->proc != 0));
+  if(n >= 2 && b->loadavg >= c->loadavg + FIXED1){
+    for(n /= 2; n > 0; n--){
+      if((p = rqpick(&b->rq, c)) == 0)
+        break;
+      rqremove(&b->rq, p);
+      p->rqcpu = c - cpus;
+      rqpush(&c->rq, p);
+      c->npulled++;
+    }
+  }
+  release(&b->rq.lock);
+}
+
+static void
+rrtick(struct proc *p)
+{
+}
+
+static int
+rryield(struct proc *p)
+{
+  return 1;
+}
+
+static int
+rrwork(struct cpu *c)
+{
+  return c->rq.len > 0 || busiest(c) != 0;
+}
+
+//PAGEBREAK: 20
+// First come first serve: run the RUNNABLE process created
+// earliest, until it gives up the CPU. Kept in a red-black
+// tree keyed by creation time.
+static struct rbtree fcfstree;
+
+static void
+fcfsenqueue(struct proc *p)
+{
+  p->rb.key = p->ctime;
+  rbinsert(&fcfstree, &p->rb);
+}
+
+static void
+fcfsdequeue(struct proc *p)
+{
+  rberase(&fcfstree, &p->rb);
+}
+
+static struct proc*
+fcfspicknext(struct cpu *c)
+{
+  struct proc *p;
+
+  if((p = rbpick(&fcfstree, c)) != 0)
+    rberase(&fcfstree, &p->rb);
+  return p;
+}
+
+static int
+fcfsyield(struct proc *p)
+{
+  return 0;
+}
+
+static int
+fcfswork(struct cpu *c)
+{
+  return fcfstree.n > 0;
+}
+
+//PAGEBREAK: 20
+// Priority based: run the RUNNABLE process with the best
+// (lowest) priority, round robin among equals. Each priority has
+// its own run queue, and pbsmap has bit i set when queue i is not
+// empty, so the best priority is found with a bit scan instead of
+// a look at every process.
+#define NPBSPRI 101   // setpriority() values 0 to 100
+
+static struct runq pbsq[NPBSPRI];
+static uint pbsmap[(NPBSPRI+31)/32];
+static int pbslen;
+
+static void
+pbsenqueue(struct proc *p)
+{
+  int i = p->priority;
+
+  rqpush(&pbsq[i], p);
+  pbsmap[i/32] |= 1 << (i%32);
+  pbslen++;
+}
+
+static void
+pbsdequeue(struct proc *p)
+{
+  int i = p->priority;
+
+  rqremove(&pbsq[i], p);
+  if(pbsq[i].len == 0)
+    pbsmap[i/32] &= ~(1 << (i%32));
+  pbslen--;
+}
+
+// Take the process at the head of the best non-empty queue,
+// or one that last ran on c among the first few there. Only
+// queues holding nothing c may run are passed over.
+static struct proc*
+pbspicknext(struct cpu *c)
+{
+  struct proc *p;
+  uint i, m;
+
+  for(i = 0; i < NELEM(pbsmap); i++){
+    for(m = pbsmap[i]; m != 0; m &= m - 1){
+      if((p = rqpick(&pbsq[i*32 + bsf(m)], c)) != 0){
+        pbsdequeue(p);
+        return p;
+      }
+    }
+  }
+  return 0;
+}
+
+static int
+pbswork(struct cpu *c)
+{
+  return pbslen > 0;
+}
+
+// Move queued p to the back of its new priority's queue.
+static void
+pbssetpriority(struct proc *p, int priority)
+{
+  pbsdequeue(p);
+  p->priority = priority;
+  pbsenqueue(p);
+}
+
+//PAGEBREAK: 30
+// Multi-level feedback queue. A process that uses up the time
+// slice of its queue is demoted to the next one; one that waits
+// AGELIMIT ticks without running is promoted. The queues are
+// shared by all cpus.
+static struct runq queue[NQUEUE];
+static volatile int nqueued;
+
+void
+qinit(void)
+{
+  for(int i = 0; i < NQUEUE; i++){
+    queue[i].head = 0;
+    queue[i].tail = 0;
+    queue[i].len = 0;
+  }
+}
+
+// Add process to the tail of a new queue
+// Does nothing if it is already queued there
+void
+addproc(struct proc *p, int id)
+{
+  if(id < 0 || id >= NQUEUE)
+    return;
+  if(p->queue == id && rqhas(&queue[id], p))
+    return;
+  rqpush(&queue[id], p);
+  nqueued++;
+  p->queue = id;
+  p->qtime = 0;
+  p->lastref = ticks;
+  return;
+}
+
+// Removes process from queue if found
+// Does nothing otherwise
+void
+removeproc(struct proc *p, int id)
+{
+  if(id < 0 || id >= NQUEUE || p->queue != id || !rqhas(&queue[id], p))
+    return;
+  rqremove(&queue[id], p);
+  nqueued--;
+  return;
+}
+
+// A process is only queued while RUNNABLE, so this is
+// either a wakeup, a new process or a preempted one.
+static void
+mlfqenqueue(struct proc *p)
+{
+  int q = p->queue;
+  if(p->demote){ // demote
+    p->demote = 0;
+    if(q < NQUEUE - 1){
+      q++;
+    }
+  }
+  p->timeslice = 0;
+  addproc(p, q);
+}
+
+static void
+mlfqdequeue(struct proc *p)
+{
+  removeproc(p, p->queue);
+}
+
+static struct proc*
+mlfqpicknext(struct cpu *c)
+{
+  struct proc *p;
+
+  // Promote processes that have waited too long. Each queue is
+  // in the order its processes were queued, so only the heads
+  // can have waited AGELIMIT ticks.
+  for(int i = 1; i < NQUEUE; i++){
+    while((p = queue[i].head) != 0 &&
+          ticks - p->lastref >= AGELIMIT){
+      removeproc(p, i);
+      addproc(p, i - 1);
+      p->timeslice = 0;
+    }
+  }
+  for(int i = 0; i < NQUEUE; i++){
+    if((p = rqpick(&queue[i], c)) != 0){
+      removeproc(p, i);
+      return p;
+    }
+  }
+  return 0;
+}
+
+static void
+mlfqtick(struct proc *p)
+{
+  if(p->timeslice >= qpriority(p->queue)){
+    p->ticks[p->queue]++;
+  }
+}
+
+// Give up the CPU, to be demoted, once the
+// time slice of the current queue is used up.
+static int
+mlfqyield(struct proc *p)
+{
+  if(p->timeslice >= qpriority(p->queue)){
+    p->demote = 1;
+    return 1;
+  }
+  return 0;
+}
+
+static int
+mlfqwork(struct cpu *c)
+{
+  return nqueued > 0;
+}
+
+//PAGEBREAK: 40
+// Completely fair: run the process with the smallest virtual
+// run time, which grows more slowly for processes with a
+// better priority.
+#define CFSWEIGHT0   1024         // weight of the default priority, 60
+#define CFSLATENCY   (8 << 10)    // most vruntime credit kept over sleeps
+
+// CFS run tree of RUNNABLE processes keyed by vruntime.
+// minvruntime only moves forward and is where woken
+// processes rejoin the tree.
+static struct rbtree cfstree;
+static uint minvruntime;
+
+// Weight of each nice level from -20 to 19, as in Linux:
+// each level gets about 1.25 times the CPU of the next one.
+static const int cfsweights[40] = {
+  88761, 71755, 56483, 46273, 36291,
+  29154, 23254, 18705, 14949, 11916,
+   9548,  7620,  6100,  4904,  3906,
+   3121,  2501,  1991,  1586,  1277,
+   1024,   820,   655,   526,   423,
+    335,   272,   215,   172,   137,
+    110,    87,    70,    56,    45,
+     36,    29,    23,    18,    15,
+};
+
+// Map a setpriority() value (0 best, 60 default, 100 worst)
+// onto a CFS weight, two priority points per nice level.
+static int
+cfsweight(int priority)
+{
+  int nice = (priority - 60) / 2;
+
+  if(nice < -20)
+    nice = -20;
+  if(nice > 19)
+    nice = 19;
+  return cfsweights[nice + 20];
+}
+
+static void
+cfsenqueue(struct proc *p)
+{
+  // Don't let a process that slept bank more than CFSLATENCY
+  // of credit over the processes that kept running.
+  if((int)(p->vruntime - (minvruntime - CFSLATENCY)) < 0)
+    p->vruntime = minvruntime - CFSLATENCY;
+  p->rb.key = p->vruntime;
+  rbinsert(&cfstree, &p->rb);
+}
+
+static void
+cfsdequeue(struct proc *p)
+{
+  rberase(&cfstree, &p->rb);
+}
+
+static struct proc*
+cfspicknext(struct cpu *c)
+{
+  struct proc *p;
+
+  if((p = rbpick(&cfstree, c)) == 0)
+    return 0;
+  rberase(&cfstree, &p->rb);
+  if((int)(p->vruntime - minvruntime) > 0)
+    minvruntime = p->vruntime;
+  return p;
+}
+
+static void
+cfstick(struct proc *p)
+{
+  p->vruntime += (CFSWEIGHT0 << 10) / cfsweight(p->priority);
+}
+
+static int
+cfswork(struct cpu *c)
+{
+  return cfstree.n > 0;
+}
+
+//PAGEBREAK: 30
+// Stride scheduling: run the process with the smallest pass,
+// which grows in inverse proportion to its tickets, so each
+// process gets a share of the CPU proportional to its tickets.
+#define STRIDE1      (1 << 20)    // pass added per tick with one ticket
+
+// Stride run tree of RUNNABLE processes keyed by pass.
+// globalpass is the pass of the last process picked,
+// where woken processes rejoin.
+static struct rbtree stridetree;
+static uint globalpass;
+
+static void
+strideenqueue(struct proc *p)
+{
+  // Sleeping doesn't earn a process any credit.
+  if((int)(p->pass - globalpass) < 0)
+    p->pass = globalpass;
+  p->rb.key = p->pass;
+  rbinsert(&stridetree, &p->rb);
+}
+
+static void
+stridedequeue(struct proc *p)
+{
+  rberase(&stridetree, &p->rb);
+}
+
+static struct proc*
+stridepicknext(struct cpu *c)
+{
+  struct proc *p;
+
+  if((p = rbpick(&stridetree, c)) == 0)
+    return 0;
+  rberase(&stridetree, &p->rb);
+  if((int)(p->pass - globalpass) > 0)
+    globalpass = p->pass;
+  return p;
+}
+
+static void
+stridetick(struct proc *p)
+{
+  p->pass += STRIDE1 / p->tickets;
+}
+
+static int
+stridework(struct cpu *c)
+{
+  return stridetree.n > 0;
+}
+
+//PAGEBREAK: 30
+static struct schedops rrops = {
+  SCHED_RR, "rr", 1,
+  rrenqueue, rrdequeue, rrpicknext, rrtick, rryield, rrwork, rrbalance, 0,
+};
+
+static struct schedops fcfsops = {
+  SCHED_FCFS, "fcfs", 0,
+  fcfsenqueue, fcfsdequeue, fcfspicknext, rrtick, fcfsyield, fcfswork, 0, 0,
+};
+
+static struct schedops pbsops = {
+  SCHED_PBS, "pbs", 0,
+  pbsenqueue, pbsdequeue, pbspicknext, rrtick, rryield, pbswork, 0,
+  pbssetpriority,
+};
+
+static struct schedops mlfqops = {
+  SCHED_MLFQ, "mlfq", 0,
+  mlfqenqueue, mlfqdequeue, mlfqpicknext, mlfqtick, mlfqyield, mlfqwork,
+  0, 0,
+};
+
+static struct schedops cfsops = {
+  SCHED_CFS, "cfs", 0,
+  cfsenqueue, cfsdequeue, cfspicknext, cfstick, rryield, cfswork, 0, 0,
+};
+
+static struct schedops strideops = {
+  SCHED_STRIDE, "stride", 0,
+  strideenqueue, stridedequeue, stridepicknext, stridetick, rryield,
+  stridework, 0, 0,
+};
+
+struct schedops *schedops[NSCHED] = {
+[SCHED_RR]      &rrops,
+[SCHED_FCFS]    &fcfsops,
+[SCHED_PBS]     &pbsops,
+[SCHED_MLFQ]    &mlfqops,
+[SCHED_CFS]     &cfsops,
+[SCHED_STRIDE]  &strideops,
+};
+
+// The policy in use, initially the one the kernel was built with.
+#if defined(FCFS)
+struct schedops *policy = &fcfsops;
+#elif defined(PBS)
+struct schedops *policy = &pbsops;
+#elif defined(MLFQ)
+struct schedops *policy = &mlfqops;
+#elif defined(CFS)
+struct schedops *policy = &cfsops;
+#elif defined(STRIDE)
+struct schedops *policy = &strideops;
+#else
+struct schedops *policy = &rrops;
+#endif
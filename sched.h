@@ -0,0 +1,8 @@
+// Scheduling policies, for schedctl().
+#define SCHED_RR      0   // Round robin
+#define SCHED_FCFS    1   // First come first serve
+#define SCHED_PBS     2   // Priority based
+#define SCHED_MLFQ    3   // Multi-level feedback queue
+#define SCHED_CFS     4   // Completely fair
+#define SCHED_STRIDE  5   // Stride (tickets)
+#define NSCHED        6
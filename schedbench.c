@@ -0,0 +1,168 @@
+// Scheduler scaling benchmark.
+// Runs pairs of processes that ping-pong a byte over two pipes
+// for a fixed number of ticks and reports how many context
+// switches the kernel performed per second, and how many times
+// the processes moved between CPUs. Then runs as many processes
+// as pairs that fork and reap children for as long, which goes
+// through process allocation and the exit/wait handshake, and
+// reports forks per second. With "pin", each pair and each
+// forker is restricted to one CPU. Boot with make qemu CPUS=1,
+// 2, 4 and 8 to compare.
+
+#include "param.h"
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "procstat.h"
+#include "cpustat.h"
+
+#define NPAIR    4    // default number of ping-pong pairs
+#define DURATION 500  // default run length in ticks
+#define HZ       100  // timer ticks per second
+#define MAXPAIR  32   // most ping-pong pairs
+#define NPS     16   // processes fetched per procinfo() call
+
+struct procstat buf[NPS];
+struct cpustat cs[NCPU];
+int pids[2*MAXPAIR];
+int res[2];  // forkers write their counts here
+
+// Bounce a byte between rfd and wfd until the deadline.
+// The first side of each pair starts the exchange.
+void
+pingpong(int rfd, int wfd, int first, uint end)
+{
+  char c = 0;
+
+  if(first && write(wfd, &c, 1) != 1)
+    exit();
+  while(uptime() < end){
+    if(read(rfd, &c, 1) != 1)
+      break;
+    if(write(wfd, &c, 1) != 1)
+      break;
+  }
+  exit();
+}
+
+// Fork and reap children until the deadline and report
+// how many were reaped.
+void
+forker(uint end)
+{
+  int pid, n = 0;
+
+  while(uptime() < end){
+    if((pid = fork()) < 0)
+      break;
+    if(pid == 0)
+      exit();
+    if(wait() != pid)
+      break;
+    n++;
+  }
+  write(res[1], &n, sizeof(n));
+  exit();
+}
+
+int
+main(int argc, char *argv[])
+{
+  int npair, duration, pin, ncpu, nproc, i, j, n, v, last, total, nmigrate;
+  int ab[2], ba[2];
+  uint end;
+
+  npair = argc > 1 ? atoi(argv[1]) : NPAIR;
+  duration = argc > 2 ? atoi(argv[2]) : DURATION;
+  pin = argc > 3 && strcmp(argv[3], "pin") == 0;
+  if(npair <= 0 || npair > MAXPAIR || duration <= 0){
+    printf(2, "usage: schedbench [pairs] [ticks] [pin]\n");
+    exit();
+  }
+  ncpu = cpuinfo(cs);
+
+  end = uptime() + duration;
+  nproc = 0;
+  for(i = 0; i < npair; i++){
+    if(pipe(ab) < 0 || pipe(ba) < 0){
+      printf(2, "schedbench: pipe failed\n");
+      exit();
+    }
+    for(j = 0; j < 2; j++){
+      pids[nproc] = fork();
+      if(pids[nproc] < 0){
+        printf(2, "schedbench: fork failed\n");
+        exit();
+      }
+      if(pids[nproc] == 0){
+        if(pin)
+          setaffinity(getpid(), 1 << (i % ncpu));
+        if(j == 0){
+          close(ab[0]);
+          close(ba[1]);
+          pingpong(ba[0], ab[1], 1, end);
+        } else {
+          close(ab[1]);
+          close(ba[0]);
+          pingpong(ab[0], ba[1], 0, end);
+        }
+      }
+      nproc++;
+    }
+    close(ab[0]);
+    close(ab[1]);
+    close(ba[0]);
+    close(ba[1]);
+  }
+
+  // Let the pairs run out their time, then count how often the
+  // kernel switched to them before reaping them.
+  while(uptime() < end)
+    sleep(end - uptime());
+  sleep(5);
+  total = 0;
+  nmigrate = 0;
+  last = 0;
+  while((n = procinfo(buf, NPS, last)) > 0){
+    for(i = 0; i < n; i++)
+      for(j = 0; j < nproc; j++)
+        if(buf[i].pid == pids[j]){
+          total += buf[i].nrun;
+          nmigrate += buf[i].nmigrate;
+        }
+    last = buf[n-1].pid;
+  }
+  for(i = 0; i < nproc; i++)
+    wait();
+
+  printf(1, "%d pairs, %d ticks: %d switches, %d switches/sec, %d migrations\n",
+         npair, duration, total, total * HZ / duration, nmigrate);
+
+  if(pipe(res) < 0){
+    printf(2, "schedbench: pipe failed\n");
+    exit();
+  }
+  end = uptime() + duration;
+  for(i = 0; i < npair; i++){
+    if((n = fork()) < 0){
+      printf(2, "schedbench: fork failed\n");
+      exit();
+    }
+    if(n == 0){
+      if(pin)
+        setaffinity(getpid(), 1 << (i % ncpu));
+      forker(end);
+    }
+  }
+  total = 0;
+  for(i = 0; i < npair; i++){
+    if(read(res[0], &v, sizeof(v)) != sizeof(v))
+      break;
+    total += v;
+  }
+  for(i = 0; i < npair; i++)
+    wait();
+  printf(1, "%d forkers, %d ticks: %d forks, %d forks/sec\n",
+         npair, duration, total, total * HZ / duration);
+  exit();
+}
@@ -0,0 +1,41 @@
+// Show or change the scheduling policy.
+//   schedctl           print the policy in use
+//   schedctl <policy>  switch to rr, fcfs, pbs, mlfq, cfs or stride
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "sched.h"
+
+char *names[NSCHED] = {
+[SCHED_RR]      "rr",
+[SCHED_FCFS]    "fcfs",
+[SCHED_PBS]     "pbs",
+[SCHED_MLFQ]    "mlfq",
+[SCHED_CFS]     "cfs",
+[SCHED_STRIDE]  "stride",
+};
+
+int
+main(int argc, char *argv[])
+{
+  int id, old;
+
+  if(argc < 2){
+    printf(1, "%s\n", names[schedctl(-1)]);
+    exit();
+  }
+  for(id = 0; id < NSCHED; id++)
+    if(strcmp(argv[1], names[id]) == 0)
+      break;
+  if(argc > 2 || id == NSCHED){
+    printf(2, "usage: schedctl [rr|fcfs|pbs|mlfq|cfs|stride]\n");
+    exit();
+  }
+  if((old = schedctl(id)) < 0){
+    printf(2, "schedctl: cannot switch to %s\n", argv[1]);
+    exit();
+  }
+  printf(1, "%s -> %s\n", names[old], names[id]);
+  exit();
+}
@@ -2,12 +2,18 @@
 #include "stat.h"
 #include "user.h"
 #include "fcntl.h"
+#include "sched.h"
 
 #define N 5000000
 #define loop 20
 #define NFORK 5
 
-int main() {
+int main(int argc, char *argv[]) {
+    // "schedulertest fair" starts every child at once with the same
+    // priority and reports how evenly the CPU was shared among them.
+    int fair = argc > 1 && strcmp(argv[1], "fair") == 0;
+    int sched = schedctl(-1);
+    int start = uptime();
     for(int i = 0; i < NFORK; i++) {
         int f = fork();
 
@@ -16,10 +22,11 @@ int main() {
             exit();
         } else if(f == 0) {
             volatile int id = getpid();
-            sleep(100 - 9 * i);
-#ifdef PBS
-            setpriority(70 + (id % 4), id);
-#endif    
+            if(!fair) {
+                sleep(100 - 9 * i);
+                if(sched == SCHED_PBS || sched == SCHED_CFS)
+                    setpriority(70 + (id % 4), id);
+            }
             // printf(1, "process %d started\n", id);
             for(int i = 0; i < loop; i++) {
                 for(int j = 0; j < N; j++) {
@@ -32,15 +39,40 @@ int main() {
         }
     }
 
-    int totalr = 0, totalw = 0;
+    // Times are in microseconds, from the kernel's nanosecond
+    // accounting, so differences under a tick still show.
+    int totalr = 0, totalw = 0, maxw = 0;
+    uint share, sum = 0, sumsq = 0;
     for(int i = 0; i < NFORK; i++){
+        uint64 rns, wns;
         int rtime, wtime;
-        waitx(&wtime, &rtime);
+        waitxns(&wns, &rns);
+        rtime = udiv64(rns, 1000);
+        wtime = udiv64(wns, 1000);
         totalr += rtime;
         totalw += wtime;
+        if(wtime > maxw)
+            maxw = wtime;
+        // Per-mille of the child's lifetime that it spent running
+        share = rtime + wtime >= 1000 ? rtime / ((rtime + wtime) / 1000) : 0;
+        if(share > 1000)
+            share = 1000;
+        sum += share;
+        sumsq += share * share;
         printf(1, "%d: %d, %d\n",i, wtime, rtime);
     }
-    printf(1, "Average:\n rtime:%d, wtime:%d\n", totalr / NFORK, totalw / NFORK);
-    printf(1, "Total:\n rtime:%d, wtime:%d\n", totalr, totalw);
+    printf(1, "Average (us):\n rtime:%d, wtime:%d\n", totalr / NFORK, totalw / NFORK);
+    printf(1, "Total (us):\n rtime:%d, wtime:%d\n", totalr, totalw);
+    // The total run time over the elapsed time rises with the
+    // number of CPUs the scheduler manages to keep busy.
+    int elapsed = uptime() - start;
+    if(elapsed > 0)
+        printf(1, "Elapsed:%d ticks, CPU usage:%d%%\n", elapsed, totalr / (elapsed * 100));
+    if(fair && sumsq > 0){
+        // Jain's fairness index, as a percentage: 100 when every
+        // child got the same share, 100/NFORK when one got it all.
+        printf(1, "Fairness index:%d%%, max wtime:%d\n",
+               sum * sum * 100 / (NFORK * sumsq), maxw);
+    }
     exit();
-}
\ No newline at end of file
+}
@@ -0,0 +1,32 @@
+#include "types.h"
+#include "fcntl.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+
+int 
+main(int argc, char** argv) 
+{
+    if(argc != 3){
+        printf(2, "usage: setaffinity pid mask\n");
+        exit();
+    }
+
+    int pid = atoi(argv[1]);
+    int mask = atoi(argv[2]);
+    if(pid <= 0){
+        printf(2, "setaffinity: Invalid arguments. Specify the pid of the process\n");
+        exit();
+    }
+    if(mask <= 0 || mask >= 1 << NCPU){
+        printf(2, "setaffinity: Invalid arguments. Bit i of mask is cpu i, below %d\n", 1 << NCPU);
+        exit();
+    }
+
+    int old = setaffinity(pid, mask);
+    if(old < 0)
+        printf(2, "setaffinity: no process %d, or no such cpu\n", pid);
+    else
+        printf(1, "Done, old mask %d\n", old);
+    exit();
+} 
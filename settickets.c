@@ -0,0 +1,31 @@
+#include "types.h"
+#include "fcntl.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+
+int 
+main(int argc, char** argv) 
+{
+    if(argc != 3){
+        printf(2, "settickets: Invalid arguments\n");
+        exit();
+    }
+
+    int pid = atoi(argv[1]);
+    int tickets = atoi(argv[2]);
+    if(pid <= 0){
+        printf(2, "settickets: Invalid arguments. Specify the pid of the process\n");
+        exit();
+    }
+    if(tickets < 1 || tickets > MAXTICKETS){
+        printf(2, "settickets: Invalid arguments. Specify between 1 and %d tickets\n", MAXTICKETS);
+        exit();
+    }
+
+    if(settickets(tickets, pid) < 0)
+        printf(2, "settickets: no process %d\n", pid);
+    else
+        printf(1, "Done\n");
+    exit();
+} 
@@ -0,0 +1,252 @@
+// Object caches, for kernel objects much smaller than a page.
+//
+// A cache hands out objects of one size. It carves slabs, blocks
+// of 2^order pages from kalloc_pages(), into as many objects as
+// fit after a small header, and keeps the slabs that have free
+// objects on a list. A free object is linked into its slab's
+// free list through the last word of its slot, so the object
+// itself keeps whatever the cache's constructor set up: an
+// object is constructed once, when its slab is made, and must
+// be in that state again when it is freed. Freeing finds the
+// slab by rounding the address down, since blocks are aligned to
+// their size. A slab whose objects are all free is kept as a
+// spare, and any more are given back.
+//
+// In front of the slabs, each cpu has a magazine of up to
+// MAGSIZE free objects, used with interrupts off and without a
+// lock. A cpu only takes the cache's lock to fill an empty
+// magazine with MAGSIZE/2 objects or to empty a full one down to
+// MAGSIZE/2, so most slaballoc() and slabfree() calls are a few
+// instructions.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "slab.h"
+#include "slabstat.h"
+
+#define SLABMINOBJ   8   // objects a slab should hold at least
+#define SLABMAXORDER 3   // largest slab, in pages as for kalloc_pages
+
+struct slab {
+  struct slabcache *sc;
+  struct slab *next;     // On sc->partial or sc->full
+  struct slab *prev;
+  void *free;            // Free objects
+  int inuse;             // Objects not on free
+};
+
+// Where a free object keeps the next free object of its slab.
+#define LINK(sc, obj) (*(void**)((char*)(obj) + (sc)->slot - sizeof(void*)))
+
+// All caches. They are set up at boot, before the other cpus
+// start, so the list needs no lock.
+static struct slabcache *caches;
+
+// Set up cache sc for objects of the given size, each set up
+// by ctor, if not 0, when its slab is made.
+void
+slabinit(struct slabcache *sc, char *name, uint size, void (*ctor)(void*))
+{
+  int i;
+
+  initlock(&sc->lock, "slab");
+  sc->name = name;
+  sc->size = size;
+  sc->slot = (size + sizeof(void*) + 7) & ~7;
+  for(sc->order = 0; sc->order < SLABMAXORDER; sc->order++)
+    if(((PGSIZE << sc->order) - sizeof(struct slab)) / sc->slot >= SLABMINOBJ)
+      break;
+  sc->perslab = ((PGSIZE << sc->order) - sizeof(struct slab)) / sc->slot;
+  if(sc->perslab == 0)
+    panic("slabinit");
+  sc->ctor = ctor;
+  sc->partial = sc->full = sc->spare = 0;
+  sc->nslab = 0;
+  sc->nout = 0;
+  for(i = 0; i < NCPU; i++){
+    sc->mag[i].n = 0;
+    sc->mag[i].nalloc = 0;
+  }
+  sc->next = caches;
+  caches = sc;
+}
+
+static void
+push(struct slab **list, struct slab *s)
+{
+  s->prev = 0;
+  s->next = *list;
+  if(s->next)
+    s->next->prev = s;
+  *list = s;
+}
+
+static void
+unlink(struct slab **list, struct slab *s)
+{
+  if(s->prev)
+    s->prev->next = s->next;
+  else
+    *list = s->next;
+  if(s->next)
+    s->next->prev = s->prev;
+}
+
+// Return an empty slab: the spare, or a new one with all its
+// objects constructed. Caller holds sc->lock.
+static struct slab*
+newslab(struct slabcache *sc)
+{
+  struct slab *s;
+  char *obj;
+  int i;
+
+  if((s = sc->spare) != 0){
+    sc->spare = 0;
+    return s;
+  }
+  if((s = (struct slab*)kalloc_pages(sc->order)) == 0)
+    return 0;
+  s->sc = sc;
+  s->inuse = 0;
+  s->free = 0;
+  for(i = sc->perslab - 1; i >= 0; i--){
+    obj = (char*)(s + 1) + i*sc->slot;
+    if(sc->ctor)
+      sc->ctor(obj);
+    LINK(sc, obj) = s->free;
+    s->free = obj;
+  }
+  sc->nslab++;
+  return s;
+}
+
+// Take a free object from the slabs, making a slab if none has
+// one. Return 0 if out of memory. Caller holds sc->lock.
+static void*
+slabget(struct slabcache *sc)
+{
+  struct slab *s;
+  void *obj;
+
+  if((s = sc->partial) == 0){
+    if((s = newslab(sc)) == 0)
+      return 0;
+    push(&sc->partial, s);
+  }
+  obj = s->free;
+  s->free = LINK(sc, obj);
+  s->inuse++;
+  if(s->free == 0){
+    unlink(&sc->partial, s);
+    push(&sc->full, s);
+  }
+  sc->nout++;
+  return obj;
+}
+
+// Give object obj back to its slab. Caller holds sc->lock.
+static void
+slabput(struct slabcache *sc, void *obj)
+{
+  struct slab *s;
+
+  s = (struct slab*)((uint)obj & ~((PGSIZE << sc->order) - 1));
+  if(s->sc != sc)
+    panic("slabfree");
+  if(s->free == 0){
+    unlink(&sc->full, s);
+    push(&sc->partial, s);
+  }
+  LINK(sc, obj) = s->free;
+  s->free = obj;
+  s->inuse--;
+  sc->nout--;
+  if(s->inuse == 0){
+    unlink(&sc->partial, s);
+    if(sc->spare == 0)
+      sc->spare = s;
+    else {
+      kfree_pages((char*)s, sc->order);
+      sc->nslab--;
+    }
+  }
+}
+
+// Allocate an object from cache sc, in the state its
+// constructor left it. Returns 0 if out of memory.
+void*
+slaballoc(struct slabcache *sc)
+{
+  struct magazine *m;
+  void *obj;
+
+  pushcli();
+  m = &sc->mag[cpuid()];
+  if(m->n == 0){
+    acquire(&sc->lock);
+    while(m->n < MAGSIZE/2 && (obj = slabget(sc)) != 0)
+      m->obj[m->n++] = obj;
+    release(&sc->lock);
+  }
+  obj = 0;
+  if(m->n > 0){
+    obj = m->obj[--m->n];
+    m->nalloc++;
+  }
+  popcli();
+  return obj;
+}
+
+// Free object obj, which must have come from cache sc and be
+// back in the state its constructor left it.
+void
+slabfree(struct slabcache *sc, void *obj)
+{
+  struct magazine *m;
+
+  pushcli();
+  m = &sc->mag[cpuid()];
+  if(m->n == MAGSIZE){
+    acquire(&sc->lock);
+    while(m->n > MAGSIZE/2)
+      slabput(sc, m->obj[--m->n]);
+    release(&sc->lock);
+  }
+  m->obj[m->n++] = obj;
+  popcli();
+}
+
+// Fill buf with the statistics of up to n caches.
+// Return how many it filled.
+int
+slabinfo(struct slabstat *buf, int n)
+{
+  struct slabcache *sc;
+  struct slabstat *st;
+  int i, k;
+
+  k = 0;
+  for(sc = caches; sc != 0 && k < n; sc = sc->next){
+    st = &buf[k++];
+    safestrcpy(st->name, sc->name, sizeof(st->name));
+    st->size = sc->size;
+    st->perslab = sc->perslab;
+    st->slabpages = 1 << sc->order;
+    st->ncached = 0;
+    st->nalloc = 0;
+    for(i = 0; i < ncpu; i++){
+      st->ncached += sc->mag[i].n;
+      st->nalloc += sc->mag[i].nalloc;
+    }
+    acquire(&sc->lock);
+    st->nslab = sc->nslab;
+    st->inuse = sc->nout - st->ncached;
+    release(&sc->lock);
+  }
+  return k;
+}
@@ -0,0 +1,27 @@
+// Object caches, see slab.c.
+
+#define MAGSIZE 16   // Objects in a per-cpu magazine
+
+// Free objects a cpu keeps for itself, used with interrupts off.
+struct magazine {
+  int n;                   // Objects in obj[]
+  void *obj[MAGSIZE];
+  uint nalloc;             // slaballoc() calls on this cpu
+};
+
+struct slabcache {
+  struct spinlock lock;    // Protects the slabs and counts below
+  char *name;
+  uint size;               // Object size, as asked for
+  uint slot;               // Bytes each object takes in a slab
+  int order;               // Slabs are 2^order pages
+  int perslab;             // Objects in each slab
+  void (*ctor)(void*);     // Sets up a new object, or 0
+  struct slab *partial;    // Slabs with free objects
+  struct slab *full;       // Slabs without
+  struct slab *spare;      // An unused slab kept for reuse, or 0
+  int nslab;               // Slabs allocated, including spare
+  int nout;                // Objects taken from the slabs
+  struct slabcache *next;  // Next on the list of all caches
+  struct magazine mag[NCPU];
+};
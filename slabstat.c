@@ -0,0 +1,29 @@
+// Print the statistics of the kernel's object caches: object
+// size, objects and pages per slab, slabs allocated, objects in
+// use and cached by the cpus, and allocations since boot.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "slabstat.h"
+
+#define NSS 16  // most caches listed
+
+struct slabstat buf[NSS];
+
+int
+main(int argc, char *argv[])
+{
+  int n, i;
+
+  if((n = slabinfo(buf, NSS)) < 0){
+    printf(2, "slabstat: slabinfo failed\n");
+    exit();
+  }
+  printf(1, "cache\tsize\tperslab\tpages\tslabs\tinuse\tcached\tallocs\n");
+  for(i = 0; i < n; i++)
+    printf(1, "%s\t%d\t%d\t%d\t%d\t%d\t%d\t%d\n", buf[i].name,
+           buf[i].size, buf[i].perslab, buf[i].slabpages, buf[i].nslab,
+           buf[i].inuse, buf[i].ncached, buf[i].nalloc);
+  exit();
+}
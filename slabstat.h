@@ -0,0 +1,10 @@
+struct slabstat {
+  char name[16];
+  int size;      // Object size in bytes
+  int perslab;   // Objects in each slab
+  int slabpages; // Pages in each slab
+  int nslab;     // Slabs allocated
+  int inuse;     // Objects allocated
+  int ncached;   // Free objects in the cpus' magazines
+  int nalloc;    // Allocations since boot
+};
@@ -1,4 +1,17 @@
 // Sleeping locks
+//
+// A process waiting for a sleep lock lends its priority to the
+// owner, so that a low priority owner can't be kept off the cpu
+// by medium priority processes while a high priority one waits.
+// If the owner is itself waiting for a lock, the priority is
+// passed on down the chain. On release the owner drops back to
+// its own priority, or to the best of the waiters for the other
+// locks it still holds.
+//
+// pilock protects p->blockedon, each lock's waiter list and,
+// while it has waiters, its owner. The waiter list changes only
+// with both lk->lk and pilock held, so either may be held to
+// see whether it is empty; uncontended locks never touch pilock.
 
 #include "types.h"
 #include "defs.h"
@@ -6,10 +19,20 @@
 #include "x86.h"
 #include "memlayout.h"
 #include "mmu.h"
-#include "proc.h"
 #include "spinlock.h"
+#include "proc.h"
 #include "sleeplock.h"
 
+#define NPICHAIN 8   // most owners a priority is passed through
+
+static struct spinlock pilock;
+
+void
+piinit(void)
+{
+  initlock(&pilock, "pi");
+}
+
 void
 initsleeplock(struct sleeplock *lk, char *name)
 {
@@ -17,27 +40,108 @@ initsleeplock(struct sleeplock *lk, char *name)
   lk->name = name;
   lk->locked = 0;
   lk->pid = 0;
+  lk->owner = 0;
+  lk->waiters = 0;
+  lk->nextheld = 0;
+}
+
+// Return the best of priority and those of lk's waiters.
+// Caller holds pilock.
+static int
+bestwaiter(struct sleeplock *lk, int priority)
+{
+  struct proc *w;
+
+  for(w = lk->waiters; w != 0; w = w->pinext)
+    if(w->priority < priority)
+      priority = w->priority;
+  return priority;
+}
+
+// Lend p's priority to the owner of lk and down the chain of
+// locks the owners are waiting for. Caller holds pilock.
+static void
+donate(struct proc *p, struct sleeplock *lk)
+{
+  struct proc *o;
+  int i;
+
+  for(i = 0; i < NPICHAIN && lk != 0; i++){
+    if((o = lk->owner) == 0 || !lendpriority(o, p->priority))
+      break;
+    lk = o->blockedon;
+  }
 }
 
 void
 acquiresleep(struct sleeplock *lk)
 {
+  struct proc *p = myproc();
+  struct proc **pp;
+  int waited = 0;
+
   acquire(&lk->lk);
   while (lk->locked) {
+    acquire(&pilock);
+    if(!waited){
+      p->blockedon = lk;
+      p->pinext = lk->waiters;
+      lk->waiters = p;
+      waited = 1;
+    }
+    donate(p, lk);
+    release(&pilock);
     sleep(lk, &lk->lk);
   }
   lk->locked = 1;
-  lk->pid = myproc()->pid;
+  lk->pid = p->pid;
+  lk->nextheld = p->held;
+  p->held = lk;
+  if(waited || lk->waiters){
+    acquire(&pilock);
+    if(waited){
+      for(pp = &lk->waiters; *pp != p; pp = &(*pp)->pinext)
+        ;
+      *pp = p->pinext;
+      p->pinext = 0;
+      p->blockedon = 0;
+    }
+    lk->owner = p;
+    lendpriority(p, bestwaiter(lk, p->priority));
+    release(&pilock);
+  } else
+    lk->owner = p;
   release(&lk->lk);
 }
 
 void
 releasesleep(struct sleeplock *lk)
 {
+  struct proc *o;
+  struct sleeplock **lp, *l;
+  int priority;
+
   acquire(&lk->lk);
+  o = lk->owner;
+  for(lp = &o->held; *lp != lk; lp = &(*lp)->nextheld)
+    ;
+  *lp = lk->nextheld;
+  lk->nextheld = 0;
+  if(lk->waiters){
+    acquire(&pilock);
+    lk->owner = 0;
+    if(o->priority < o->basepriority){
+      priority = o->basepriority;
+      for(l = o->held; l != 0; l = l->nextheld)
+        priority = bestwaiter(l, priority);
+      restorepriority(o, priority);
+    }
+    release(&pilock);
+  } else
+    lk->owner = 0;
   lk->locked = 0;
   lk->pid = 0;
-  wakeup(lk);
+  wakeone(lk);  // only one waiter can get the lock
   release(&lk->lk);
 }
 
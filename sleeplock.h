@@ -3,6 +3,11 @@ struct sleeplock {
   uint locked;       // Is the lock held?
   struct spinlock lk; // spinlock protecting this sleep lock
   
+  // For priority inheritance, see sleeplock.c:
+  struct proc *owner;          // Process holding lock
+  struct proc *waiters;        // Processes waiting for it
+  struct sleeplock *nextheld;  // Next lock the owner holds
+
   // For debugging:
   char *name;        // Name of lock.
   int pid;           // Process holding lock
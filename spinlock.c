@@ -6,8 +6,8 @@
 #include "x86.h"
 #include "memlayout.h"
 #include "mmu.h"
-#include "proc.h"
 #include "spinlock.h"
+#include "proc.h"
 
 void
 initlock(struct spinlock *lk, char *name)
@@ -42,6 +42,26 @@ acquire(struct spinlock *lk)
   getcallerpcs(&lk, lk->pcs);
 }
 
+// Acquire the lock if it is free, without spinning.
+// Return 1 if it was acquired, 0 if not.
+int
+tryacquire(struct spinlock *lk)
+{
+  pushcli();
+  if(holding(lk))
+    panic("tryacquire");
+
+  if(xchg(&lk->locked, 1) != 0){
+    popcli();
+    return 0;
+  }
+  __sync_synchronize();
+
+  lk->cpu = mycpu();
+  getcallerpcs(&lk, lk->pcs);
+  return 1;
+}
+
 // Release the lock.
 void
 release(struct spinlock *lk)
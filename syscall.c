@@ -3,6 +3,7 @@
 #include "param.h"
 #include "memlayout.h"
 #include "mmu.h"
+#include "spinlock.h"
 #include "proc.h"
 #include "x86.h"
 #include "syscall.h"
@@ -21,6 +22,8 @@ fetchint(uint addr, int *ip)
 
   if(addr >= curproc->sz || addr+4 > curproc->sz)
     return -1;
+  if(uvmprepare(curproc->pgdir, curproc->sz, addr, 4, 0) < 0)
+    return -1;
   *ip = *(int*)(addr);
   return 0;
 }
@@ -39,6 +42,9 @@ fetchstr(uint addr, char **pp)
   *pp = (char*)addr;
   ep = (char*)curproc->sz;
   for(s = *pp; s < ep; s++){
+    if((s == *pp || (uint)s % PGSIZE == 0) &&
+       uvmprepare(curproc->pgdir, curproc->sz, (uint)s, 1, 0) < 0)
+      return -1;
     if(*s == 0)
       return s - *pp;
   }
@@ -52,11 +58,8 @@ argint(int n, int *ip)
   return fetchint((myproc()->tf->esp) + 4 + 4*n, ip);
 }
 
-// Fetch the nth word-sized system call argument as a pointer
-// to a block of memory of size bytes.  Check that the pointer
-// lies within the process address space.
-int
-argptr(int n, char **pp, int size)
+static int
+argblock(int n, char **pp, int size, int write)
 {
   int i;
   struct proc *curproc = myproc();
@@ -65,10 +68,31 @@ argptr(int n, char **pp, int size)
     return -1;
   if(size < 0 || (uint)i >= curproc->sz || (uint)i+size > curproc->sz)
     return -1;
+  if(uvmprepare(curproc->pgdir, curproc->sz, i, size, write) < 0)
+    return -1;
   *pp = (char*)i;
   return 0;
 }
 
+// Fetch the nth word-sized system call argument as a pointer
+// to a block of memory of size bytes that the kernel only reads.
+// Check that the pointer lies within the process address space,
+// and make the block safe for the kernel to read (see
+// uvmprepare), failing if there is no memory for that.
+int
+argptr(int n, char **pp, int size)
+{
+  return argblock(n, pp, size, 0);
+}
+
+// Like argptr, for a block the kernel writes: pages shared
+// copy-on-write are copied first.
+int
+argptrw(int n, char **pp, int size)
+{
+  return argblock(n, pp, size, 1);
+}
+
 // Fetch the nth word-sized system call argument as a string pointer.
 // Check that the pointer is valid and the string is nul-terminated.
 // (There is no shared writable memory, so the string can't change
@@ -101,6 +125,16 @@ extern int sys_read(void);
 extern int sys_sbrk(void);
 extern int sys_sleep(void);
 extern int sys_setpriority(void);
+extern int sys_settickets(void);
+extern int sys_setrt(void);
+extern int sys_rtwait(void);
+extern int sys_schedctl(void);
+extern int sys_cpuinfo(void);
+extern int sys_yieldto(void);
+extern int sys_waitxns(void);
+extern int sys_setaffinity(void);
+extern int sys_meminfo(void);
+extern int sys_slabinfo(void);
 extern int sys_unlink(void);
 extern int sys_wait(void);
 extern int sys_waitx(void);
@@ -132,6 +166,16 @@ static int (*syscalls[])(void) = {
 [SYS_waitx]   sys_waitx,
 [SYS_setpriority]   sys_setpriority,
 [SYS_procinfo] sys_procinfo,
+[SYS_settickets] sys_settickets,
+[SYS_setrt]    sys_setrt,
+[SYS_rtwait]   sys_rtwait,
+[SYS_schedctl] sys_schedctl,
+[SYS_cpuinfo]  sys_cpuinfo,
+[SYS_yieldto]  sys_yieldto,
+[SYS_waitxns]  sys_waitxns,
+[SYS_setaffinity] sys_setaffinity,
+[SYS_meminfo]  sys_meminfo,
+[SYS_slabinfo] sys_slabinfo,
 };
 
 void
@@ -23,3 +23,13 @@
 #define SYS_waitx        22
 #define SYS_setpriority  23
 #define SYS_procinfo     24
+#define SYS_settickets   25
+#define SYS_setrt        26
+#define SYS_rtwait       27
+#define SYS_schedctl     28
+#define SYS_cpuinfo      29
+#define SYS_yieldto      30
+#define SYS_waitxns      31
+#define SYS_setaffinity  32
+#define SYS_meminfo      33
+#define SYS_slabinfo     34
@@ -5,8 +5,12 @@
 #include "param.h"
 #include "memlayout.h"
 #include "mmu.h"
+#include "spinlock.h"
 #include "proc.h"
 #include "procstat.h"
+#include "cpustat.h"
+#include "memstat.h"
+#include "slabstat.h"
 
 int
 sys_fork(void)
@@ -32,13 +36,25 @@ sys_waitx(void)
 {
   int *wtime, *rtime;
   
-  if(argptr(0, (char **)&wtime, sizeof(int)) <  0)
+  if(argptrw(0, (char **)&wtime, sizeof(int)) <  0)
     return -1;
-  if(argptr(1, (char **)&rtime, sizeof(int)) <  0)
+  if(argptrw(1, (char **)&rtime, sizeof(int)) <  0)
     return -1;
   return waitx(wtime, rtime);
 }
 
+int
+sys_waitxns(void)
+{
+  uint64 *wtime, *rtime;
+
+  if(argptrw(0, (char **)&wtime, sizeof(uint64)) < 0)
+    return -1;
+  if(argptrw(1, (char **)&rtime, sizeof(uint64)) < 0)
+    return -1;
+  return waitxns(wtime, rtime);
+}
+
 int
 sys_kill(void)
 {
@@ -73,21 +89,12 @@ int
 sys_sleep(void)
 {
   int n;
-  uint ticks0;
 
   if(argint(0, &n) < 0)
     return -1;
-  acquire(&tickslock);
-  ticks0 = ticks;
-  while(ticks - ticks0 < n){
-    if(myproc()->killed){
-      release(&tickslock);
-      return -1;
-    }
-    sleep(&ticks, &tickslock);
-  }
-  release(&tickslock);
-  return 0;
+  if(n <= 0)
+    return 0;
+  return sleepticks(n);
 }
 
 // return how many clock tick interrupts have occurred
@@ -118,13 +125,115 @@ sys_setpriority(void)
   return setpriority(priority, pid);
 }
 
+int
+sys_settickets(void)
+{
+  int pid;
+  int tickets;
+
+  if(argint(0, &tickets) < 0)
+    return -1;
+
+  if(argint(1, &pid) < 0)
+    return -1;
+
+  return settickets(tickets, pid);
+}
+
+int
+sys_setaffinity(void)
+{
+  int pid, mask;
+
+  if(argint(0, &pid) < 0 || argint(1, &mask) < 0)
+    return -1;
+  return setaffinity(pid, mask);
+}
+
+int
+sys_setrt(void)
+{
+  int period, runtime, deadline;
+
+  if(argint(0, &period) < 0 || argint(1, &runtime) < 0 ||
+     argint(2, &deadline) < 0)
+    return -1;
+  return setrt(period, runtime, deadline);
+}
+
+int
+sys_rtwait(void)
+{
+  return rtwait();
+}
+
+int
+sys_schedctl(void)
+{
+  int id;
+
+  if(argint(0, &id) < 0)
+    return -1;
+  return schedctl(id);
+}
+
 int
 sys_procinfo(void)
 { 
   struct procstat *p;
+  int n, pid;
 
-  if(argptr(0, (void *)&p, sizeof(*p)) < 0)
+  if(argint(1, &n) < 0 || argint(2, &pid) < 0)
     return -1;
-  processinfo(p);
+  if(n < 0 || n > KERNBASE / sizeof(*p))
+    return -1;
+  if(argptrw(0, (void *)&p, n*sizeof(*p)) < 0)
+    return -1;
+  return processinfo(p, n, pid);
+}
+
+int
+sys_cpuinfo(void)
+{
+  struct cpustat *c;
+
+  if(argptrw(0, (void *)&c, NCPU*sizeof(*c)) < 0)
+    return -1;
+  return cpuinfo(c);
+}
+
+int
+sys_yieldto(void)
+{
+  int pid;
+
+  if(argint(0, &pid) < 0)
+    return -1;
+  return yieldto(pid);
+}
+
+int
+sys_meminfo(void)
+{
+  struct memstat *ms;
+
+  if(argptrw(0, (void *)&ms, sizeof(*ms)) < 0)
+    return -1;
+  meminfo(ms);
   return 0;
-}
\ No newline at end of file
+}
+
+int
+sys_slabinfo(void)
+{
+  struct slabstat *s;
+  int n;
+
+  if(argint(1, &n) < 0)
+    return -1;
+  if(n < 0 || n > KERNBASE / sizeof(*s))
+    return -1;
+  if(argptrw(0, (void *)&s, n*sizeof(*s)) < 0)
+    return -1;
+  return slabinfo(s, n);
+}
@@ -20,9 +20,10 @@ main(int argc, char ** argv)
       exit();
     }  
   } else {
-    int rtime, wtime;
-    waitx(&wtime, &rtime);
-    printf(1, "\nwaiting:%d\nrunning:%d\n", wtime, rtime);
+    uint64 rtime, wtime;
+    waitxns(&wtime, &rtime);
+    printf(1, "\nwaiting:%d us\nrunning:%d us\n",
+           (int)udiv64(wtime, 1000), (int)udiv64(rtime, 1000));
   }
   exit();
 }
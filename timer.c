@@ -0,0 +1,192 @@
+// Timer wheel.
+//
+// A kernel timer calls a function at a given tick. Timers are
+// kept in a hierarchical wheel of NLEVEL levels of NSLOT slots:
+// a timer due within NSLOT ticks sits in the level 0 slot for
+// its exact tick, one due within NSLOT^2 ticks in the level 1
+// slot for its group of NSLOT ticks, and so on. Every NSLOT
+// ticks the next level 1 slot is cascaded down into level 0,
+// and likewise up the levels. Adding and removing a timer is
+// O(1), and each tick only looks at the timers that are due.
+//
+// The wheel is protected by tickslock. timertick() runs on
+// cpu 0 on every tick and calls the due timers' functions
+// with tickslock held.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "timer.h"
+
+#define LVLBITS   6
+#define NSLOT     (1 << LVLBITS)
+#define SLOTMASK  (NSLOT - 1)
+#define NLEVEL    4
+#define MAXDELAY  ((1 << (NLEVEL*LVLBITS)) - 1)  // longest delay the wheel holds
+
+static struct timer *wheel[NLEVEL][NSLOT];
+static uint wheeltime;  // Next tick timertick() will process
+
+// Put t in the slot for t->expires.
+static void
+enqueue(struct timer *t)
+{
+  uint expires, delay;
+  int lvl;
+  struct timer **slot;
+
+  expires = t->expires;
+  if((int)(expires - wheeltime) < 0)
+    expires = wheeltime;  // overdue: run on the next tick
+  delay = expires - wheeltime;
+  if(delay > MAXDELAY){
+    // Park it as far out as the wheel reaches; it is
+    // requeued from there when that slot is cascaded.
+    expires = wheeltime + MAXDELAY;
+    delay = MAXDELAY;
+  }
+  for(lvl = 0; lvl < NLEVEL-1; lvl++)
+    if(delay < 1 << ((lvl+1)*LVLBITS))
+      break;
+  slot = &wheel[lvl][(expires >> (lvl*LVLBITS)) & SLOTMASK];
+
+  t->prev = 0;
+  t->next = *slot;
+  if(*slot)
+    (*slot)->prev = t;
+  *slot = t;
+  t->slot = slot;
+}
+
+// Take t off the wheel.
+static void
+dequeue(struct timer *t)
+{
+  if(t->prev)
+    t->prev->next = t->next;
+  else
+    *t->slot = t->next;
+  if(t->next)
+    t->next->prev = t->prev;
+  t->next = t->prev = 0;
+  t->slot = 0;
+}
+
+// Set up t to call fn(arg) when it expires.
+void
+timerinit(struct timer *t, void (*fn)(void*), void *arg)
+{
+  t->fn = fn;
+  t->arg = arg;
+  t->slot = 0;
+  t->next = t->prev = 0;
+}
+
+// Arrange for t->fn(t->arg) to be called at tick expires.
+// Caller must hold tickslock, and t must not be pending.
+void
+timeradd(struct timer *t, uint expires)
+{
+  if(t->slot)
+    panic("timeradd");
+  t->expires = expires;
+  enqueue(t);
+}
+
+// Cancel t if it is pending. Caller must hold tickslock.
+void
+timerdel(struct timer *t)
+{
+  if(t->slot)
+    dequeue(t);
+}
+
+// Move the timers in slot i of level lvl down the wheel.
+static void
+cascade(int lvl, int i)
+{
+  struct timer *t;
+
+  while((t = wheel[lvl][i]) != 0){
+    dequeue(t);
+    enqueue(t);
+  }
+}
+
+// Run the timers due by now. Called on every tick,
+// after ticks has been incremented, with tickslock held.
+void
+timertick(void)
+{
+  struct timer *t;
+  int idx, lvl, i;
+
+  while((int)(ticks - wheeltime) >= 0){
+    idx = wheeltime & SLOTMASK;
+    if(idx == 0){
+      for(lvl = 1; lvl < NLEVEL; lvl++){
+        i = (wheeltime >> (lvl*LVLBITS)) & SLOTMASK;
+        cascade(lvl, i);
+        if(i != 0)
+          break;
+      }
+    }
+    while((t = wheel[0][idx]) != 0){
+      dequeue(t);
+      t->fn(t->arg);
+    }
+    wheeltime++;
+  }
+}
+
+// Sleep until tick when, holding tickslock. Sleeps on a timer
+// of its own, which wakes the caller once, at the deadline,
+// rather than on every tick. t is on the caller's stack, so it
+// must be off the wheel before returning, even if when had
+// already passed and the loop never slept.
+static int
+sleeptimer(uint when)
+{
+  struct timer t;
+  int r;
+
+  timerinit(&t, wakeup, &t);
+  timeradd(&t, when);
+  r = 0;
+  while((int)(ticks - when) < 0){
+    if(myproc()->killed){
+      r = -1;
+      break;
+    }
+    sleep(&t, &tickslock);
+  }
+  timerdel(&t);
+  return r;
+}
+
+// Sleep until tick when. Return -1 if killed before then.
+int
+sleepuntil(uint when)
+{
+  int r;
+
+  acquire(&tickslock);
+  r = sleeptimer(when);
+  release(&tickslock);
+  return r;
+}
+
+// Sleep for n ticks from now. Return -1 if killed before then.
+int
+sleepticks(uint n)
+{
+  int r;
+
+  acquire(&tickslock);
+  r = sleeptimer(ticks + n);
+  release(&tickslock);
+  return r;
+}
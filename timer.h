@@ -0,0 +1,9 @@
+// Kernel timers, see timer.c.
+struct timer {
+  uint expires;           // Tick at which to call fn
+  void (*fn)(void*);      // Called with tickslock held
+  void *arg;              // Argument for fn
+  struct timer **slot;    // Wheel slot it is in, 0 if not pending
+  struct timer *next;     // Next timer in the same slot
+  struct timer *prev;     // Previous timer in the same slot
+};
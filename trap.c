@@ -3,10 +3,10 @@
 #include "param.h"
 #include "memlayout.h"
 #include "mmu.h"
+#include "spinlock.h"
 #include "proc.h"
 #include "x86.h"
 #include "traps.h"
-#include "spinlock.h"
 
 // Interrupt descriptor table (shared by all CPUs).
 struct gatedesc idt[256];
@@ -51,10 +51,24 @@ trap(struct trapframe *tf)
     if(cpuid() == 0){
       acquire(&tickslock);
       ticks++;
-      updatetime();
-      wakeup(&ticks);
+      rttick();
+      timertick();
       release(&tickslock);
     }
+    // Sample what this CPU was doing for cpuinfo(), and
+    // charge its process for the tick.
+    if(myproc()){
+      mycpu()->busyticks++;
+      updatetime();
+    } else
+      mycpu()->idleticks++;
+    balance();
+    lapiceoi();
+    break;
+  case T_IRQ0 + IRQ_RESCHED:
+    // Nothing to do: the interrupt has woken this CPU
+    // out of hlt, and scheduler() will look for work.
+    mycpu()->nresched++;
     lapiceoi();
     break;
   case T_IRQ0 + IRQ_IDE:
@@ -79,6 +93,22 @@ trap(struct trapframe *tf)
     lapiceoi();
     break;
 
+  case T_PGFLT:
+    // The first touch of a heap page sbrk() only reserved, or
+    // a write to a page fork() shared copy-on-write. Either may
+    // come from user space or from the kernel using a user
+    // address in a system call.
+    if(myproc() && (tf->err & FEC_PR) == 0 &&
+       lazyfault(myproc()->pgdir, myproc()->sz, rcr2()) == 0)
+      break;
+    if(myproc() && (tf->err & FEC_WR) &&
+       cowfault(myproc()->pgdir, rcr2()) == 0)
+      break;
+    // Otherwise a bad address, or no memory for the page. The
+    // kernel can't get here that way: system calls prepare the
+    // user memory they use with argptr(), argptrw(), fetchint()
+    // and fetchstr(), which fail the call instead. So it is user
+    // space, and default kills the process.
   //PAGEBREAK: 13
   default:
     if(myproc() == 0 || (tf->cs&3) == 0){
@@ -101,32 +131,14 @@ trap(struct trapframe *tf)
   if(myproc() && myproc()->killed && (tf->cs&3) == DPL_USER)
     exit();
 
-#ifndef FCFS
-#ifndef MLFQ 
-  // Force process to give up CPU on clock tick.
+  // Force process to give up CPU on clock tick if its
+  // scheduling policy or a real-time job says so.
   // If interrupts were on while locks held, would need to check nlock.
   if(myproc() && myproc()->state == RUNNING &&
-     tf->trapno == T_IRQ0+IRQ_TIMER)
+     tf->trapno == T_IRQ0+IRQ_TIMER && preempt(myproc()))
     yield();
 
   // Check if the process has been killed since we yielded
   if(myproc() && myproc()->killed && (tf->cs&3) == DPL_USER)
     exit();
-#endif
-#ifdef MLFQ
-  if(myproc() && myproc()->state == RUNNING &&
-     tf->trapno == T_IRQ0+IRQ_TIMER){
-    struct proc* p = myproc();
-    // process to give up CPU if not done in required ticks;
-    if(p->timeslice >= qpriority(p->queue)){
-      p->demote = 1;
-      yield();
-    }
-  }
-  
-  // Check if the process has been killed since we yielded
-  if(myproc() && myproc()->killed && (tf->cs&3) == DPL_USER)
-    exit();
-#endif
-#endif
 }
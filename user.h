@@ -1,4 +1,7 @@
 struct procstat;
+struct cpustat;
+struct memstat;
+struct slabstat;
 struct stat;
 struct rtcdate;
 
@@ -7,6 +10,7 @@ int fork(void);
 int exit(void) __attribute__((noreturn));
 int wait(void);
 int waitx(int *, int *);
+int waitxns(uint64*, uint64*);
 int pipe(int*);
 int write(int, const void*, int);
 int read(int, void*, int);
@@ -21,12 +25,21 @@ int link(const char*, const char*);
 int mkdir(const char*);
 int chdir(const char*);
 int setpriority(int, int);
+int settickets(int, int);
+int setaffinity(int, int);
+int meminfo(struct memstat*);
+int slabinfo(struct slabstat*, int);
+int setrt(int, int, int);
+int rtwait(void);
+int schedctl(int);
 int dup(int);
 int getpid(void);
 char* sbrk(int);
 int sleep(int);
 int uptime(void);
-int procinfo(struct procstat*);
+int procinfo(struct procstat*, int, int);
+int cpuinfo(struct cpustat*);
+int yieldto(int);
 
 // ulib.c*
 int stat(const char*, struct stat*);
@@ -41,3 +54,4 @@ void* memset(void*, int, uint);
 void* malloc(uint);
 void free(void*);
 int atoi(const char*);
+uint64 udiv64(uint64, uint);
@@ -1376,14 +1376,16 @@ iref(void)
 // test that fork fails gracefully
 // the forktest binary also does this, but it runs out of proc entries first.
 // inside the bigger usertests binary, we run out of memory first.
-void
-forktest(void)
+// Fork until fork fails, then reap every child.
+// Return the number of children.
+int
+forkfill(void)
 {
   int n, pid;
 
-  printf(1, "fork test\n");
-
-  for(n=0; n<1000; n++){
+  // The process table grows on demand, so fork only fails
+  // once kernel memory runs out.
+  for(n=0; n<100000; n++){
     pid = fork();
     if(pid < 0)
       break;
@@ -1391,8 +1393,8 @@ forktest(void)
       exit();
   }
 
-  if(n == 1000){
-    printf(1, "fork claimed to work 1000 times!\n");
+  if(n == 100000){
+    printf(1, "fork claimed to work 100000 times!\n");
     exit();
   }
 
@@ -1407,6 +1409,23 @@ forktest(void)
     printf(1, "wait got too many\n");
     exit();
   }
+  return n;
+}
+
+void
+forktest(void)
+{
+  int n, m;
+
+  printf(1, "fork test\n");
+
+  n = forkfill();
+  // Reaping must have given back what the children took,
+  // so fork gets about as far again.
+  if((m = forkfill()) < n - n/10){
+    printf(1, "fork failed after %d forks, %d before reaping\n", m, n);
+    exit();
+  }
 
   printf(1, "fork test OK\n");
 }
@@ -4,6 +4,7 @@
 #include "x86.h"
 #include "memlayout.h"
 #include "mmu.h"
+#include "spinlock.h"
 #include "proc.h"
 #include "elf.h"
 
@@ -311,31 +312,37 @@ clearpteu(pde_t *pgdir, char *uva)
 }
 
 // Given a parent process's page table, create a copy
-// of it for a child.
+// of it for a child. The pages themselves are not copied
+// but shared: writable ones are made read-only and marked
+// copy-on-write in both page tables, and cowfault() gives
+// whichever process writes first its own copy.
 pde_t*
 copyuvm(pde_t *pgdir, uint sz)
 {
   pde_t *d;
   pte_t *pte;
   uint pa, i, flags;
-  char *mem;
 
   if((d = setupkvm()) == 0)
     return 0;
   for(i = 0; i < sz; i += PGSIZE){
-    if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0)
-      panic("copyuvm: pte should exist");
+    // Skip heap pages that have never been touched.
+    if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0){
+      i = PGADDR(PDX(i) + 1, 0, 0) - PGSIZE;
+      continue;
+    }
     if(!(*pte & PTE_P))
-      panic("copyuvm: page not present");
+      continue;
     pa = PTE_ADDR(*pte);
     flags = PTE_FLAGS(*pte);
-    if((mem = kalloc()) == 0)
-      goto bad;
-    memmove(mem, (char*)P2V(pa), PGSIZE);
-    if(mappages(d, (void*)i, PGSIZE, V2P(mem), flags) < 0) {
-      kfree(mem);
-      goto bad;
+    if(flags & PTE_W){
+      flags = (flags & ~PTE_W) | PTE_COW;
+      *pte = pa | flags;
+      invlpg((void*)i);
     }
+    if(mappages(d, (void*)i, PGSIZE, pa, flags) < 0)
+      goto bad;
+    kref(P2V(pa));
   }
   return d;
 
@@ -344,6 +351,83 @@ bad:
   return 0;
 }
 
+// Handle a fault at user address va, below sz, on a page not
+// present in page table pgdir: a heap page growproc() only
+// reserved, touched for the first time. Map a zeroed page there.
+// Return -1 if va is above sz or there is no memory.
+int
+lazyfault(pde_t *pgdir, uint sz, uint va)
+{
+  char *mem;
+
+  va = PGROUNDDOWN(va);
+  if(va >= sz)
+    return -1;
+  if((mem = kalloc()) == 0)
+    return -1;
+  memset(mem, 0, PGSIZE);
+  if(mappages(pgdir, (char*)va, PGSIZE, V2P(mem), PTE_W|PTE_U) < 0){
+    kfree(mem);
+    return -1;
+  }
+  return 0;
+}
+
+// Handle a write fault at user address va in page table
+// pgdir. If the page is shared copy-on-write, give pgdir its
+// own writable copy, or just make it writable if no other
+// page table maps it any more. Return -1 if it is not such a
+// page or there is no memory for the copy.
+int
+cowfault(pde_t *pgdir, uint va)
+{
+  pte_t *pte;
+  uint pa, flags;
+  char *mem;
+
+  if(va >= KERNBASE || (pte = walkpgdir(pgdir, (void*)va, 0)) == 0)
+    return -1;
+  if((*pte & (PTE_P|PTE_U|PTE_COW)) != (PTE_P|PTE_U|PTE_COW))
+    return -1;
+  pa = PTE_ADDR(*pte);
+  flags = (PTE_FLAGS(*pte) | PTE_W) & ~PTE_COW;
+  if(krefs(P2V(pa)) > 1){
+    if((mem = kalloc()) == 0)
+      return -1;
+    memmove(mem, (char*)P2V(pa), PGSIZE);
+    *pte = V2P(mem) | flags;
+    kfree(P2V(pa));
+  } else
+    *pte = pa | flags;
+  invlpg((void*)va);
+  return 0;
+}
+
+// Make the user pages of pgdir covering [va, va+len), below
+// sz, safe for the kernel to use: map any heap page not yet
+// touched, and if write, give the process its own copy of any
+// it shares copy-on-write. System calls do this before using a
+// user buffer, so that running out of memory for a page fails
+// the call rather than faulting in the kernel. That maps the
+// whole buffer, even the part the call turns out not to use.
+// Return -1 if there is no memory.
+int
+uvmprepare(pde_t *pgdir, uint sz, uint va, uint len, int write)
+{
+  pte_t *pte;
+  uint a;
+
+  for(a = PGROUNDDOWN(va); a < va + len; a += PGSIZE){
+    pte = walkpgdir(pgdir, (void*)a, 0);
+    if(pte == 0 || (*pte & PTE_P) == 0){
+      if(lazyfault(pgdir, sz, a) < 0)
+        return -1;
+    } else if(write && (*pte & PTE_COW) && cowfault(pgdir, a) < 0)
+      return -1;
+  }
+  return 0;
+}
+
 //PAGEBREAK!
 // Map user virtual address to kernel address.
 char*
@@ -361,7 +445,9 @@ uva2ka(pde_t *pgdir, char *uva)
 
 // Copy len bytes from p to user address va in page table pgdir.
 // Most useful when pgdir is not the current page table.
-// uva2ka ensures this only works for PTE_U pages.
+// uva2ka ensures this only works for PTE_U pages. It writes
+// through the kernel mapping, so pgdir must not share pages
+// copy-on-write: exec uses it on a new page table.
 int
 copyout(pde_t *pgdir, uint va, void *p, uint len)
 {
@@ -117,6 +117,46 @@ sti(void)
   asm volatile("sti");
 }
 
+// Enable interrupts and halt until the next one. The sti
+// takes effect only after the hlt, so an interrupt that was
+// pending while they were off still wakes the hlt.
+static inline void
+stihlt(void)
+{
+  asm volatile("sti; hlt");
+}
+
+// Read the time-stamp counter, which counts cpu cycles.
+static inline uint64
+rdtsc(void)
+{
+  uint64 val;
+
+  asm volatile("rdtsc" : "=A" (val));
+  return val;
+}
+
+// Index of the lowest set bit of a non-zero val.
+static inline uint
+bsf(uint val)
+{
+  uint r;
+
+  asm("bsfl %1,%0" : "=r" (r) : "rm" (val) : "cc");
+  return r;
+}
+
+// Atomically add v to *addr and return the old value.
+static inline ushort
+xaddw(volatile ushort *addr, ushort v)
+{
+  asm volatile("lock; xaddw %0, %1" :
+               "+r" (v), "+m" (*addr) :
+               :
+               "cc");
+  return v;
+}
+
 static inline uint
 xchg(volatile uint *addr, uint newval)
 {
@@ -144,6 +184,13 @@ lcr3(uint val)
   asm volatile("movl %0,%%cr3" : : "r" (val));
 }
 
+// Drop the TLB entry for the page holding va.
+static inline void
+invlpg(void *va)
+{
+  asm volatile("invlpg (%0)" : : "r" (va) : "memory");
+}
+
 //PAGEBREAK: 36
 // Layout of the trap frame built on the stack by the
 // hardware and by trapasm.S, and passed to trap().